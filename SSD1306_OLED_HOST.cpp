@@ -0,0 +1,267 @@
+/*
+** SSD1306_OLED_HOST — SSD1306 emulator for building SSD1306_OLED_HW_I2C_LIB on a PC
+** Part of SSD1306_OLED_HW_I2C_LIB, see SSD1306_OLED_HOST.h
+*/
+
+#include "SSD1306_OLED_HW_I2C_LIB.h"
+
+#if OLED_TRANSPORT == OLED_TRANSPORT_HOST   // compiles to nothing in AVR builds
+
+#include "SSD1306_OLED_HOST.h"
+
+uint8_t TWBR, TWSR, CLKPR, SREG = 0x80, PORTD;
+
+OLED_HOST_PANEL oled_host_panels[OLED_HOST_PANELS];
+uint8_t oled_host_nack = 0;
+
+static OLED_HOST_PANEL *target;                     // display addressed by the current transaction
+static uint8_t to_mux;                              // 1 while the current transaction goes to the mux
+static uint8_t mux_channel;                         // channel mask last written to the mux
+static uint8_t want_control;                        // next byte is a control byte
+static uint8_t co, dc;                              // Co and D/C# bits of the last control byte
+static uint8_t twi_open;                                                // a START has been sent, no STOP yet
+static uint8_t twi_address;                                             // next TWDR write is the address byte
+static uint8_t twi_pending;                                             // interrupt raised, handler not run yet
+static uint8_t twi_in_handler;
+
+#define HOST_W(address)                 (((address) < 0x78) ? (address) << 1 : (address))
+
+void oled_host_reset(void) {
+    memset(oled_host_panels, 0, sizeof(oled_host_panels));
+    target = 0;
+    to_mux = 0;
+    mux_channel = 0;
+    oled_host_nack = 0;
+    twi_open = 0;
+    twi_address = 0;
+    twi_pending = 0;
+}
+
+OLED_HOST_PANEL *oled_host_find(uint8_t address, uint8_t channel) {
+    address = HOST_W(address);
+    for (uint8_t i = 0; i < OLED_HOST_PANELS; i++) {
+        OLED_HOST_PANEL *p = &oled_host_panels[i];
+        if (p->address == address && p->channel == channel) return p;
+    }
+    return 0;
+}
+
+static OLED_HOST_PANEL *panel_new(uint8_t address, uint8_t channel) {  // a display just powered up (datasheet reset values)
+    for (uint8_t i = 0; i < OLED_HOST_PANELS; i++) {
+        OLED_HOST_PANEL *p = &oled_host_panels[i];
+        if (p->address) continue;
+        memset(p, 0, sizeof(*p));
+        p->address = address;
+        p->channel = channel;
+        p->width = OLED_WIDTH;
+        p->col_offset = (OLED_WIDTH == 64) ? 32 : 0;
+        p->col_hi = 127;
+        p->page_hi = 7;
+        p->mode = 2;
+        p->contrast = 0x7F;
+        p->mux_ratio = 63;
+        return p;
+    }
+    return 0;                                                           // all slots in use: NACK
+}
+
+static uint8_t cmd_length(uint8_t cmd) {                               // command byte plus arguments
+    switch (cmd) {
+        case 0x20: case 0x81: case 0x8D: case 0xA8: case 0xD3: case 0xD5: case 0xD9: case 0xDA: case 0xDB:
+            return 2;
+        case 0x21: case 0x22: case 0xA3:
+            return 3;
+        case 0x29: case 0x2A:
+            return 6;
+        case 0x26: case 0x27: case 0x2C: case 0x2D:
+            return 7;
+    }
+    return 1;
+}
+
+static void cmd_run(OLED_HOST_PANEL *p) {
+    const uint8_t *c = p->cmd;
+    if (c[0] <= 0x0F) p->col = (p->col & 0xF0) | c[0];                 // page addressing: column low nibble
+    else if (c[0] <= 0x1F) p->col = (p->col & 0x0F) | ((c[0] & 0x07) << 4);
+    else if (c[0] == 0x20) p->mode = c[1] & 0x03;
+    else if (c[0] == 0x21 && p->mode != 2) {                            // column range (horizontal / vertical only)
+        p->col_lo = c[1] & 0x7F;
+        p->col_hi = c[2] & 0x7F;
+        p->col = p->col_lo;
+    } else if (c[0] == 0x22 && p->mode != 2) {                          // page range
+        p->page_lo = c[1] & 0x07;
+        p->page_hi = c[2] & 0x07;
+        p->page = p->page_lo;
+    } else if (c[0] >= 0x40 && c[0] <= 0x7F) p->start_line = c[0] & 0x3F;
+    else if (c[0] == 0x81) p->contrast = c[1];
+    else if (c[0] == 0x8D) p->charge_pump = (c[1] & 0x04) != 0;
+    else if (c[0] == 0xA4 || c[0] == 0xA5) p->all_on = c[0] & 1;
+    else if (c[0] == 0xA6 || c[0] == 0xA7) p->inverse = c[0] & 1;
+    else if (c[0] == 0xA8) p->mux_ratio = c[1] & 0x3F;
+    else if (c[0] == 0xAE || c[0] == 0xAF) p->display_on = c[0] & 1;
+    else if (c[0] >= 0xB0 && c[0] <= 0xB7) p->page = c[0] & 0x07;    // page addressing: page
+    else if (c[0] == 0x2C || c[0] == 0x2D) {                            // content scroll by one column
+        uint8_t lo = c[5] & 0x7F, hi = c[6] & 0x7F;
+        for (uint8_t page = c[2] & 7; page <= (c[4] & 7) && lo < hi; page++) {
+            uint8_t *ram = p->gddram[page];
+            if (c[0] == 0x2D) {                                         // left: column lo comes back at hi
+                uint8_t out = ram[lo];
+                memmove(&ram[lo], &ram[lo + 1], hi - lo);
+                ram[hi] = out;
+            } else {
+                uint8_t out = ram[hi];
+                memmove(&ram[lo + 1], &ram[lo], hi - lo);
+                ram[lo] = out;
+            }
+        }
+    }
+}
+
+static void data_write(OLED_HOST_PANEL *p, uint8_t data) {             // write at the RAM pointer and advance it
+    p->gddram[p->page & 7][p->col & 127] = data;
+    p->data++;
+    if (p->mode == 0) {                                                 // horizontal
+        if (++p->col > p->col_hi) {
+            p->col = p->col_lo;
+            if (++p->page > p->page_hi) p->page = p->page_lo;
+        }
+    } else if (p->mode == 1) {                                          // vertical
+        if (++p->page > p->page_hi) {
+            p->page = p->page_lo;
+            if (++p->col > p->col_hi) p->col = p->col_lo;
+        }
+    } else {                                                            // page: wraps within the page
+        p->col = (p->col + 1) & 127;
+    }
+}
+
+uint8_t oled_host_start(uint8_t address) {
+    target = 0;
+    to_mux = 0;
+    if (oled_host_nack) {
+        oled_host_nack--;
+        return 0;
+    }
+    if (address >= 0xE0 && address <= 0xEE && !(address & 1)) {        // TCA9548A
+        to_mux = 1;
+        return 1;
+    }
+    if (address != 0x78 && address != 0x7A) return 0;                  // not an SSD1306 address
+    target = oled_host_find(address, mux_channel);
+    if (!target) target = panel_new(address, mux_channel);
+    if (!target) return 0;
+    target->transactions++;
+    want_control = 1;
+    return 1;
+}
+
+uint8_t oled_host_write(uint8_t data) {
+    if (to_mux) {
+        mux_channel = data;
+        return 1;
+    }
+    OLED_HOST_PANEL *p = target;
+    if (!p) return 0;
+    if (want_control) {
+        co = data >> 7;
+        dc = (data >> 6) & 1;
+        want_control = 0;
+        return 1;
+    }
+    if (dc) {
+        data_write(p, data);
+    } else {
+        p->commands++;
+        if (p->cmd_got == 0) p->cmd_len = cmd_length(data);            // a command may span transactions
+        p->cmd[p->cmd_got++] = data;
+        if (p->cmd_got >= p->cmd_len) {
+            cmd_run(p);
+            p->cmd_got = 0;
+        }
+    }
+    if (co) want_control = 1;                                           // Co=1: one byte per control byte
+    return 1;
+}
+
+void oled_host_stop(void) {
+    target = 0;
+    to_mux = 0;
+}
+
+// TWI module
+// TWSR status codes of the master transmitter: 0x08 START, 0x10 repeated START, 0x18 / 0x20 address
+// ACK / NACK, 0x28 / 0x30 data ACK / NACK, 0xF8 nothing to report (after a STOP). A pending interrupt
+// stays pending while the handler runs, so handler calls follow each other instead of nesting.
+
+extern "C" void oled_host_twi_vect(void) __attribute__((weak));        // defined by the library in async mode
+
+OLED_HOST_TWCR TWCR;
+uint8_t TWDR;
+uint8_t oled_host_twi_hold = 0;
+
+static void twi_status(uint8_t status) {
+    TWSR = (TWSR & 0x03) | status;
+}
+
+static void twi_deliver(void) {                                         // run the handler while interrupts keep coming
+    if (!oled_host_twi_hold) while (oled_host_twi_run(0xFFFF));
+}
+
+OLED_HOST_TWCR &OLED_HOST_TWCR::operator=(uint8_t control) {
+    value = control & ~((1<<TWINT) | (1<<TWSTO));                     // TWINT cleared by the write, STOP done at once
+    if (!(control & (1<<TWINT)) || !(control & (1<<TWEN))) return *this;
+    if (control & (1<<TWSTO)) {
+        if (twi_open) oled_host_stop();
+        twi_open = 0;
+        twi_status(0xF8);
+        if (!(control & (1<<TWSTA))) return *this;                     // a STOP alone raises no interrupt
+    }
+    if (control & (1<<TWSTA)) {
+        twi_status(twi_open ? 0x10 : 0x08);
+        if (twi_open) oled_host_stop();                                 // repeated START: the emulator starts over
+        twi_open = 1;
+        twi_address = 1;
+    } else if (twi_address) {
+        twi_address = 0;
+        twi_status(oled_host_start(TWDR) ? 0x18 : 0x20);
+    } else {
+        twi_status(oled_host_write(TWDR) ? 0x28 : 0x30);
+    }
+    value |= 1<<TWINT;
+    twi_pending = 1;
+    twi_deliver();
+    return *this;
+}
+
+uint16_t oled_host_twi_run(uint16_t count) {
+    uint16_t ran = 0;
+    if (twi_in_handler || !oled_host_twi_vect) return 0;               // the handler's own TWCR writes do not nest
+    twi_in_handler = 1;
+    while (ran < count && twi_pending && (TWCR.value & (1<<TWIE))) {
+        twi_pending = 0;
+        oled_host_twi_vect();
+        ran++;
+    }
+    twi_in_handler = 0;
+    return ran;
+}
+
+uint8_t oled_host_pixel(const OLED_HOST_PANEL *p, uint8_t x, uint8_t y) {
+    if (!p || !p->display_on || x >= p->width || y > p->mux_ratio) return 0;
+    if (p->all_on) return 1;
+    uint8_t row = (y + p->start_line) & 63;                             // the start line is shown at the top
+    uint8_t bit = (p->gddram[row >> 3][(x + p->col_offset) & 127] >> (row & 7)) & 1;
+    return bit ^ p->inverse;
+}
+
+void oled_host_write_pbm(const OLED_HOST_PANEL *p, FILE *file) {
+    fprintf(file, "P1\n%d %d\n", p->width, p->mux_ratio + 1);
+    for (uint8_t y = 0; y <= p->mux_ratio; y++) {
+        for (uint8_t x = 0; x < p->width; x++) {
+            fputc(oled_host_pixel(p, x, y) ? '1' : '0', file);
+        }
+        fputc('\n', file);
+    }
+}
+
+#endif
@@ -0,0 +1,123 @@
+/*
+** SSD1306_OLED_HOST — SSD1306 emulator for building SSD1306_OLED_HW_I2C_LIB on a PC
+** Part of SSD1306_OLED_HW_I2C_LIB, see SSD1306_OLED_HW_I2C_LIB.h
+
+When the library is compiled for anything but an AVR, OLED_TRANSPORT defaults to OLED_TRANSPORT_HOST and the
+bus primitives talk to this emulator instead of the TWI hardware. It decodes the I2C stream the way the
+controller does (control bytes, Co/D/C bits, command arguments, addressing modes, column/page windows) into
+a model of its 128x8 page GDDRAM, and counts transactions, command bytes and data bytes per display.
+Render-cost benchmarks and golden-image tests can so run without hardware:
+
+    g++ -I. SSD1306_OLED_HW_I2C_LIB.cpp SSD1306_OLED_HOST.cpp my_test.cpp
+
+    SSD1306_OLED_HW_I2C_LIB lcd;
+    lcd.D_INIT();
+    lcd.D_DRAW_HOR(0, 9, 128);
+    OLED_HOST_PANEL *panel = oled_host_find(SLA_W, 0);
+    oled_host_pixel(panel, 0, 9);                   // 1
+    oled_host_write_pbm(panel, file);               // screen as a PBM image
+
+Displays are created when first addressed (0x3C / 0x3D, 8-bit 0x78 / 0x7A); a TCA9548A at 0x70-0x77 is
+emulated too, and a display addressed while a mux channel is selected is a separate panel per channel.
+Async mode (OLED_ASYNC) runs against a model of the TWI module: TWCR writes perform the bus step on the
+emulated displays at once and raise the TWI interrupt, which is delivered as soon as the library returns
+from the handler, or held back while oled_host_twi_hold is set (the queue then stays busy until
+oled_host_twi_run). Continuous scrolling is not emulated (the one-column content scroll 0x2C / 0x2D is).
+
+This header also stands in for the AVR headers the library uses (PROGMEM, cli/sei, delays, and plain
+variables for the registers that only configure the hardware).
+*/
+
+
+#ifndef SSD1306_OLED_HOST_h
+#define SSD1306_OLED_HOST_h
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define OLED_HOST_PANELS                4           // displays that can be emulated at the same time
+
+struct OLED_HOST_PANEL {
+    uint8_t address;                                // 8-bit write address (0 = slot unused)
+    uint8_t channel;                                // mux channel mask selected when first addressed (0 = none)
+    uint8_t width;                                  // glass: columns shown (default OLED_WIDTH, set it for a
+    uint8_t col_offset;                             // narrower panel) and the GDDRAM column of the first one
+    uint8_t gddram[8][128];                         // controller RAM: 8 pages of 128 columns, bit 0 on top
+    uint8_t col, page;                              // RAM pointer
+    uint8_t col_lo, col_hi, page_lo, page_hi;       // window set by 0x21 / 0x22
+    uint8_t mode;                                   // 0x20: 0 = horizontal, 1 = vertical, 2 = page addressing
+    uint8_t start_line;                             // 0x40-0x7F
+    uint8_t contrast;                               // 0x81
+    uint8_t mux_ratio;                              // 0xA8: rows - 1
+    uint8_t display_on;                             // 0xAE / 0xAF
+    uint8_t all_on;                                 // 0xA4 / 0xA5
+    uint8_t inverse;                                // 0xA6 / 0xA7
+    uint8_t charge_pump;                            // 0x8D
+    uint32_t transactions;                          // transactions addressed to this display
+    uint32_t commands;                              // command bytes (with their arguments)
+    uint32_t data;                                  // data bytes written to GDDRAM
+    uint8_t cmd[7];                                 // command being received
+    uint8_t cmd_len;
+    uint8_t cmd_got;
+};
+
+extern OLED_HOST_PANEL oled_host_panels[OLED_HOST_PANELS];
+extern uint8_t oled_host_nack;                      // NACK the next n address bytes (display absent / busy)
+
+void oled_host_reset(void);                         // forget all displays (power cycle)
+OLED_HOST_PANEL *oled_host_find(uint8_t address, uint8_t channel);   // display by 7- or 8-bit address, 0 if never used
+uint8_t oled_host_pixel(const OLED_HOST_PANEL *panel, uint8_t x, uint8_t y);   // 1 if lit on the screen
+void oled_host_write_pbm(const OLED_HOST_PANEL *panel, FILE *file);    // width x mux ratio rows PBM image
+
+// TWI module (async mode)
+extern uint8_t oled_host_twi_hold;                  // 1 = hold TWI interrupts back (bus stalled)
+uint16_t oled_host_twi_run(uint16_t count);         // deliver up to count held interrupts, returns how many ran
+
+// Transport used by the library (BUS_START / BUS_WRITE / BUS_STOP)
+uint8_t oled_host_start(uint8_t address);           // 1 if the address is ACKed
+uint8_t oled_host_write(uint8_t data);              // 1 if the byte is ACKed
+void oled_host_stop(void);
+
+
+// AVR stand-ins
+#ifndef F_CPU
+#define F_CPU                           16000000UL
+#endif
+#define PROGMEM
+#define PSTR(s)                         (s)
+#define pgm_read_byte(p)                (*(const uint8_t *)(p))
+#define pgm_read_word(p)                (*(const uint16_t *)(p))
+#define memcpy_P                        memcpy
+#define cli()                           ((void)0)
+#define sei()                           ((void)0)
+#define _delay_us(us)                   ((void)0)
+#define _delay_ms(ms)                   ((void)0)
+
+extern uint8_t TWBR, TWSR, CLKPR, SREG, PORTD; // written and read back like the registers, nothing else
+#define CLKPCE                          7
+#define CLKPS0                          0
+#define CLKPS1                          1
+
+struct OLED_HOST_TWCR {                             // TWCR: a write with TWINT set performs the bus step
+    uint8_t value;
+    operator uint8_t() const { return value; }
+    OLED_HOST_TWCR &operator=(uint8_t control);
+};
+extern OLED_HOST_TWCR TWCR;
+extern uint8_t TWDR;                                // TWSR bits 3-7 hold the status of the last step
+#define TWINT                           7
+#define TWEA                            6
+#define TWSTA                           5
+#define TWSTO                           4
+#define TWEN                            2
+#define TWIE                            0
+#define TWI_vect                        oled_host_twi_vect
+#define ISR(vector)                     extern "C" void vector(void)
+#define SLEEP_MODE_IDLE                 0
+#define set_sleep_mode(mode)            ((void)(mode))
+#define sleep_enable()                  ((void)0)
+#define sleep_disable()                 ((void)0)
+#define sleep_cpu()                     ((void)oled_host_twi_run(1))    // the next interrupt wakes the CPU
+
+#endif
@@ -7,18 +7,71 @@
 
 This library is designed to control a 128x64 OLED display with an SSD1306 controller over I2C. In essence, it is a minimalistic adaptation of a library written for ATTiny85 and similar micro-controllers. The purpose of this adaptation is to reduce the memory footprint, and add hardware support for I2C communication (supported on ATmega328P, ATmega32U4 and some other micro-controllers). The library can be used with Arduino IDE or in a plain C environment.
 
+Other panel sizes (e.g. 128x32, 64x48) and the I2C address are set per instance, so different panels can be driven side by side: SSD1306_OLED_HW_I2C_LIB lcd2(0, 0x3D, 64, 48);
+Displays with the same address can sit behind a TCA9548A I2C multiplexer, see D_SET_MUX(). All instances share the bus, and D_FLUSH_ALL() sends their framebuffer changes page by page in turn.
+Besides the AVR TWI hardware the library can use the Arduino Wire library (SAMD, RP2040, STM32, ...) or a 4-wire SPI panel through the SPI library, see OLED_TRANSPORT in SSD1306_OLED_HW_I2C_LIB.h.
+
 The following functions have been implemented in the library:
    - initialize display				D_INIT();
+   - re-initialize after a power glitch		D_REINIT_FAST();	// only registers that differ from reset, then the framebuffer
    - clear display					D_CLEAR();
+   - fill screen with a byte pattern		D_FILL(pattern);  // 0x00 = clear, 0xFF = all on, 0x55 = stripes
+   - fill area with a byte pattern		D_FILL_RECT(x [0-127], page [0-7], width, pages, pattern);
+   - blank without clearing GDDRAM		D_BLANK(OLED_BLANK_DARK / OLED_BLANK_LIT / OLED_BLANK_OFF);
    - turn off (sleep)					D_OFF();
    - turn on (wake up)					D_ON();
+   - dim / power down when idle			D_SET_IDLE(dim after, off after, dim contrast); D_IDLE_TICK(millis());
+   - undo idle dimming / power down		D_WAKE();	// also done by the next draw
+   - idle manager state				D_POWER();	// OLED_POWER_ON / _DIM / _OFF
    - change brightness (same as contrast)		D_CONTRAST (0-255 or 0x00-0xFF);	
    - set position					D_SETPOS(x coordinate [0-127], character row [0-7]);	// (0,0) corresponds to the upper left corner, 
    - print string (8x6 ascii font)			D_PRINT_STR(“string”);
+   - print string from flash			D_PRINT_STR_P(PSTR("string"));
+   - formatted output, no buffer			D_PRINTF("%5u rpm", rpm); D_PRINTF_P(PSTR("%S: %d"), name_P, value);
+   - stream text in one transaction		D_PRINT_BEGIN(); ... D_PRINT_END();	// also print() / println() (Arduino Print)
+   - select font (PROGMEM OLED_FONT descriptor)	D_SET_FONT(&OLED_FONT_6x8);
+   - width of a string in pixels			D_TEXT_WIDTH("string");
+   - print string 2x / 4x / 8x as large		D_PRINT_STR_SCALED("string", scale);
+   - text size of D_PRINT_*			D_SET_SCALE(1 / 2 / 4 / 8);
    - print variable(integers only)			D_PRINT_INT(integer or int variable);
+   - print unsigned, zero/space padded		D_PRINT_UINT(value, width, pad);
+   - print signed, zero/space padded		D_PRINT_SINT(value, width, pad);
+   - print hexadecimal				D_PRINT_HEX(value, digits);
+   - print fixed point (-1234,2 -> -12.34)	D_PRINT_FIXED(value, decimals, width, pad);
+   - numeric field (redraws changed digits)		D_FIELD_INIT(&field, x, row, width); D_FIELD_UINT(&field, value); D_FIELD_SINT(&field, value);
+   - rolling plot (sends the new column only)	D_PLOT_INIT(&plot, x, page, width, pages, min, max, OLED_PLOT_SCROLL); D_PLOT_PUSH(&plot, value); D_PLOT_REDRAW(&plot);
+   - text grid of 6x8 cells (sends changed cells)	D_GRID_INIT(&grid); D_GRID_STR(&grid, col, row, "text", OLED_GRID_INVERSE); D_GRID_FLUSH(&grid);
+   - frame animation (PROGMEM, XOR deltas)		D_ANIM_START(&anim, &frames, x, page, interval, loop, millis()); D_ANIM_TICK(&anim, millis());	// late frames are skipped
    - draw horizontal line				D_DRAW_HOR(starting x coordinate [0-127], starting y coordinate [0-63], length);
    - draw vertical line				D_DRAW_VERT(starting x coordinate [0-127], starting y coordinate [0-63], length);
+   - draw filled rectangle				D_DRAW_BOX(x [0-127], y [0-63], width, height);
+   - draw rectangle outline				D_DRAW_FRAME(x [0-127], y [0-63], width, height);
+   - drawing mode of lines, boxes and shapes	D_SET_DRAW_MODE(OLED_DRAW_SET / OLED_DRAW_CLEAR / OLED_DRAW_INVERT);	// framebuffer mode
+   - set / read a pixel (framebuffer mode)		D_PIXEL(x, y); D_GET_PIXEL(x, y);
+   - draw line at any angle (framebuffer mode)	D_LINE(x0, y0, x1, y1);
+   - draw circle (framebuffer mode)		D_CIRCLE(x, y, radius); D_FILL_CIRCLE(x, y, radius);
+   - draw bitmap (page-major, from PROGMEM)		D_DRAW_BITMAP(x [0-127], page [0-7], width, pages, bitmap);  // _RAM: from SRAM, _RLE: run-length encoded
    - demonstration mode				D_DEMO();
+   - hardware horizontal scroll			D_SCROLL_H(left [0/1], start page, end page, speed [OLED_SCROLL_*]);
+   - hardware diagonal scroll			D_SCROLL_DIAG(left [0/1], start page, end page, speed, rows per step);
+   - stop hardware scroll			D_SCROLL_STOP();
+   - set display start line			D_START_LINE(row [0-63]);
+   - scrolling text console			D_CONSOLE_CLEAR(); D_CONSOLE_LINE(“text”);
+   - set I2C clock frequency			D_SET_CLOCK(Hz);	// or SSD1306_OLED_HW_I2C_LIB lcd(400000);
+   - find fastest working I2C clock		D_TUNE_CLOCK(min Hz, max Hz);
+   - set I2C error handler			D_ON_ERROR(function(uint8_t status));	// default: ERROR_PIN on PORTD is lit
+   - do other work during long transfers		D_ON_YIELD(function(void), every n bytes);	// interrupts stay enabled while sending
+   - read and clear last I2C error		D_STATUS();
+   - bus counters (with OLED_STATS 1)		D_GET_STATS(&stats); D_RESET_STATS();
+   - set I2C start retries			D_SET_RETRIES(count);
+   - display behind a TCA9548A I2C mux		D_SET_MUX(mux address [0x70-0x77], channel [0-7]);
+   - send framebuffer changes (framebuffer mode)	D_FLUSH();
+   - flush all displays, a page each in turn	SSD1306_OLED_HW_I2C_LIB::D_FLUSH_ALL();	// D_FLUSH_STEP(): one page per call
+   - show back buffer (double buffering)		D_SWAP();
+   - merge transactions (Co=1, repeated START)	D_BATCH_BEGIN(); ... D_BATCH_END();
+   - check for pending transfers (async mode)		D_BUSY();
+   - wait for pending transfers (async mode)		D_WAIT();
+   - wait in MCU idle sleep (async mode)		D_SLEEP_WAIT();
 
 Note: even though it is possible to specify the exact y coordinate in D_DRAW_HOR, 8 adjacent pixel rows will be rendered (but only one of these rows will light up). As a result any text that was printed in the same group of rows will be overwritten. For example, the following code will result in the line completely erasing the text because pixel rows 0-6 will be rendered dark:
 
@@ -26,6 +79,8 @@ D_SETPOS(0, 1);
 D_PRINT_STR(“some text”);
 D_DRAW_HOR(0, 7, 128);
 
+This does not apply when the library is built with OLED_FRAMEBUFFER set to 1: lines are then OR-ed into a RAM copy of the display (or cleared / inverted, see D_SET_DRAW_MODE), and D_FLUSH() sends only the columns that changed. D_PIXEL, D_LINE and the circles need the framebuffer.
+
 
 Below are credits from the original SSD1306 library:
 
@@ -42,12 +97,44 @@ Below are credits from the original SSD1306 library:
   * Original source code at: https://bitbucket.org/boyanov/avr/src/default/lcdddd/src/lcdddd/lcdddd.h
 */
 
+#include "SSD1306_OLED_HW_I2C_LIB.h"
+
+#if OLED_TRANSPORT == OLED_TRANSPORT_HOST
+#include "SSD1306_OLED_HOST.h"          // AVR stand-ins and the display emulator
+#elif defined(__AVR__)
 #include <avr/pgmspace.h>
 #include <avr/io.h>
 #include <avr/interrupt.h>
+#include <avr/sleep.h>
 #include <util/delay.h>
+#endif
+#if OLED_TRANSPORT == OLED_TRANSPORT_WIRE
+#include <Arduino.h>
+#include <Wire.h>
+#elif OLED_TRANSPORT == OLED_TRANSPORT_SPI
+#include <Arduino.h>
+#include <SPI.h>
+#endif
+#include <string.h>
 
-#include "SSD1306_OLED_HW_I2C_LIB.h"
+// The AVR registers (TWBR, CLKPR, SREG, PORTD) exist on the AVR, and as plain variables on the host
+#if defined(__AVR__) || (OLED_TRANSPORT == OLED_TRANSPORT_HOST)
+#define OLED_AVR_REGS                   1
+#else
+#define OLED_AVR_REGS                   0
+#endif
+
+#if OLED_AVR_REGS
+#define OLED_IRQ_SAVE(sreg)             do { sreg = SREG; cli(); } while (0)
+#define OLED_IRQ_RESTORE(sreg)          (SREG = (sreg))
+#else                                   // other Arduino cores
+#define cli()                           noInterrupts()
+#define sei()                           interrupts()
+#define _delay_us(us)                   delayMicroseconds(us)
+#define _delay_ms(ms)                   delay(ms)
+#define OLED_IRQ_SAVE(sreg)             do { sreg = 0; noInterrupts(); } while (0)
+#define OLED_IRQ_RESTORE(sreg)          ((void)(sreg), interrupts())
+#endif
 
 //  ASCII 6x8 font with leading zero bytes (character padding) removed
 //  Each byte represents a column of 8 pixels
@@ -143,11 +230,21 @@ const uint8_t D_FONT6x8 [] PROGMEM = {
     0x44, 0x28, 0x10, 0x28, 0x44, // x 88
     0x1C, 0xA0, 0xA0, 0xA0, 0x7C, // y 89
     0x44, 0x64, 0x54, 0x4C, 0x44, // z 90
+    0x00, 0x08, 0x36, 0x41, 0x00, // { 91
+    0x00, 0x00, 0x7F, 0x00, 0x00, // | 92
+    0x00, 0x41, 0x36, 0x08, 0x00, // } 93
+    0x08, 0x04, 0x08, 0x10, 0x08, // ~ 94
 };
 
+// Built-in font: ' ' to '~', 5 columns per glyph plus 1 blank column in front
+const OLED_FONT OLED_FONT_6x8 PROGMEM = { D_FONT6x8, 0, ' ', '~', 5, 1, 1 };
 
-// Display initialization sequence
-const uint8_t init_sequence [] PROGMEM = {
+
+// Display initialization sequences (OLED_PROFILE_*)
+// The registers that depend on the geometry and the profile of the instance (mux ratio, COM pins,
+// oscillator, V_COMH) are not in the tables, D_TX_GEOMETRY sends them.
+#if !OLED_FIXED_GEOMETRY || (OLED_INIT_PROFILE == OLED_PROFILE_STANDARD)
+const uint8_t init_standard [] PROGMEM = {
 	0xAE,			// Display OFF (sleep mode)
 	0x20, 0b00,		// Set Memory Addressing Mode
 					// 00=Horizontal Addressing Mode; 01=Vertical Addressing Mode;
@@ -160,336 +257,3003 @@ const uint8_t init_sequence [] PROGMEM = {
 	0x81, 0x00,		// Set contrast control register
 	0xA1,			// Set Segment Re-map. A0=address mapped; A1=address 127 mapped. 
 	0xA6,			// Set display mode. A6=Normal; A7=Inverse
-	0xA8, 0x3F,		// Set multiplex ratio(1 to 64)
 	0xA4,			// Output RAM to Display
 					// 0xA4=Output follows RAM content; 0xA5,Output ignores RAM content
 	0xD3, 0x00,		// Set display offset. 00 = no offset
-	0xD5,			// --set display clock divide ratio/oscillator frequency
-	0xF0,			// --set divide ratio
-	0xD9, 0x22,		// Set pre-charge period
-	0xDA, 0x12,		// Set com pins hardware configuration		
-	0xDB,			// --set vcomh
-	0x20,			// 0x20,0.77xVcc
-	0x8D, 0x14,		// Set DC-DC enable
-	0xAF			// Display ON in normal mode
+	0xD9, OLED_PRECHARGE,	// Set pre-charge period
+	0x8D, OLED_CHARGE_PUMP ? 0x14 : 0x10,	// Set DC-DC enable
 };
-
-
-/*
-// An alternative initialization sequence
-const uint8_t init_sequence [] PROGMEM = {	// Initialization Sequence
+#endif
+#if !OLED_FIXED_GEOMETRY || (OLED_INIT_PROFILE == OLED_PROFILE_SHORT)
+const uint8_t init_short [] PROGMEM = {	// Initialization Sequence
     0xAE,			// Display OFF (sleep mode)
-    0xA8, 0x3F,     // Set mux ratio tp select max number of rows - 64
     0xD3, 0x00,		// Set display offset. 00 = no offset
     0xA1,			// Set Segment Re-map. A0=address mapped; A1=address 127 mapped.
 	0xC8,			// Set COM Output Scan Direction
-    0xDA, 0x12,     // Default - alternate COM pin map
     0x81, 0x00,		// Set contrast control register
 	0xA4,			// Set display to enable rendering from GDDRAM (Graphic Display Data RAM)
     0xA6,			// Set display mode. A6=Normal; A7=Inverse
-	0xD5, 0x80,     // Default oscillator clock (alt 0xF0)
-    0x8D, 0x14,     // Enable the charge pump
-    0xD9, 0x22,		// Set pre-charge period
-	0xDB, 0x30,     // Set the V_COMH deselect volatage to max (alt 0x20 for 0.77xVcc)
+    0x8D, OLED_CHARGE_PUMP ? 0x14 : 0x10,	// Enable the charge pump
+    0xD9, OLED_PRECHARGE,	// Set pre-charge period
     0x20, 0b00,		// Set Memory Addressing Mode
                     // 00=Horizontal Addressing Mode; 01=Vertical Addressing Mode;
                     // 10=Page Addressing Mode (RESET); 11=Invalid
-    0xAF			// Display ON in normal mode
 };
-*/
+#endif
+
+// Warm re-initialization (D_REINIT_FAST): only the registers whose setting differs from the reset value,
+// since that is what a supply glitch or a controller reset loses. The values compared here are constants,
+// so the table shrinks at compile time; D_TX_GEOMETRY adds the geometry and profile registers that differ.
+const uint8_t reinit_sequence [] PROGMEM = {
+	0x20, 0b00,		// horizontal addressing (reset: page addressing)
+	0xA1, 0xC8,		// segment re-map, COM scan direction (reset: 0xA0, 0xC0)
+#if OLED_PRECHARGE != 0x22
+	0xD9, OLED_PRECHARGE,	// pre-charge (reset: 0x22)
+#endif
+#if OLED_CHARGE_PUMP
+	0x8D, 0x14,		// charge pump (reset: off)
+#endif
+};
 
-char ssd1306_numdec_buffer[USINT2DECASCII_MAX_DIGITS + 1];
+#if (OLED_WIDTH > 128) || (OLED_HEIGHT > 64) || (OLED_HEIGHT % 8)
+#error "OLED_WIDTH / OLED_HEIGHT: at most 128 x 64, height a multiple of 8"
+#endif
+#if OLED_FIXED_GEOMETRY && (OLED_INIT_PROFILE != OLED_PROFILE_STANDARD) && (OLED_INIT_PROFILE != OLED_PROFILE_SHORT)
+#error "Unknown OLED_INIT_PROFILE"
+#endif
 
 //constructors
 
-SSD1306_OLED_HW_I2C_LIB::SSD1306_OLED_HW_I2C_LIB(void)
+#if OLED_FIXED_GEOMETRY
+SSD1306_OLED_HW_I2C_LIB::SSD1306_OLED_HW_I2C_LIB(uint32_t scl_hz, uint8_t address)
+{
+#else
+SSD1306_OLED_HW_I2C_LIB::SSD1306_OLED_HW_I2C_LIB(uint32_t scl_hz, uint8_t address, uint8_t width, uint8_t height,
+                                                 uint8_t profile, uint8_t col_offset)
+{
+  disp_width = (width == 0 || width > OLED_WIDTH) ? OLED_WIDTH : width;    // the framebuffer holds no more
+  disp_height = (height < 8 || height > OLED_HEIGHT) ? OLED_HEIGHT : height & 0xF8;
+  disp_pages = disp_height / 8;
+  this->col_offset = (col_offset != OLED_COL_AUTO) ? col_offset : (disp_width == 64) ? 32 : 0;
+  init_profile = profile;
+#endif
+  sla_w = (address < 0x78) ? address << 1 : address;   // 7-bit address, or 8-bit write address (7-bit 0x78+ is reserved)
+  scl_init = scl_hz;   // the TWI registers are left alone until D_INIT: other instances or Wire may share the bus
+  mux_w = 0;
+  mux_mask = 0;
+  next_display = displays;
+  displays = this;
+  error_handler = 0;
+  yield_handler = 0;
+  yield_every = 0;
+  yield_left = 0;
+  con_lines = 0;
+  con_top = 0;
+  last_status = OLED_OK;
+  D_SET_FONT(&OLED_FONT_6x8);
+  text_scale = 1;
+  batch = 0;
+  batch_open = BATCH_NONE;
+  batch_collect = 0;
+  batch_len = 0;
+  cur_x = 0;
+  cur_page = 0;
+  pos_lost = 0;
+  print_nest = 0;
+  print_open = 0;
+  contrast = 0;
+  start_line = 0;
+  power_state = OLED_POWER_ON;
+  idle_busy = 1;
+  idle_contrast = 0;
+  idle_dim = 0;
+  idle_off = 0;
+  idle_since = 0;
+#if !OLED_ASYNC
+  tx_status = OLED_OK;
+#endif
+#if OLED_DOUBLE_BUFFER
+  fb = fb_buf[0];
+  fb_front = fb_buf[1];
+  fb_sent = 0;
+#if OLED_PAGE_FLIP
+  fb_half = 0;
+  memset(last_lo, 0, sizeof(last_lo));      // the hidden half is unknown: the first swap to it sends everything
+  memset(last_hi, disp_width - 1, sizeof(last_hi));
+#endif
+#endif
+#if OLED_FRAMEBUFFER
+  flush_page = 0;
+  draw_mode = OLED_DRAW_SET;
+  D_CLEAR();      // blank RAM copy, whole screen dirty so the first D_FLUSH() overwrites any GDDRAM garbage
+#else
+  win_full = 1;   // D_INIT sets the full column/page range
+#endif
+}
+
+SSD1306_OLED_HW_I2C_LIB::~SSD1306_OLED_HW_I2C_LIB()
 {
-  // SCL bit rate = CLK / (16 + 2*TWBR*[TWSR prescaler])
-  TWSR = 0x00;    // I2C prescaler 1
-  TWBR = 2;       // I2C divider 2
+  D_BATCH_END();
+  D_WAIT();       // queued frames may point into fb[]
+  for (SSD1306_OLED_HW_I2C_LIB **link = &displays; *link; link = &(*link)->next_display) {
+    if (*link == this) {
+      *link = next_display;
+      break;
+    }
+  }
+  if (flush_turn == this) flush_turn = 0;
+  if (bus_owner == this) bus_owner = 0;
 }
 
 
 void SSD1306_OLED_HW_I2C_LIB::CLK_DIV_1(void) {          // Set clock divider to 1 (fast operation)
-    cli();
+#if OLED_AVR_REGS
+    uint8_t sreg;
+    OLED_IRQ_SAVE(sreg);                   // timed sequence: CLKPR must be written within 4 cycles
     CLKPR = (1<<CLKPCE);
     CLKPR = 0x00;                          // div 1
-    sei();
+    OLED_IRQ_RESTORE(sreg);
+#endif
 }
 
 void SSD1306_OLED_HW_I2C_LIB::CLK_DIV_8(void) {          // Set clock divider to 8 (slow operation)
-    cli();
+#if OLED_AVR_REGS
+    uint8_t sreg;
+    OLED_IRQ_SAVE(sreg);                   // timed sequence: CLKPR must be written within 4 cycles
     CLKPR = (1<<CLKPCE);
     CLKPR = (1<<CLKPS1)|(1<<CLKPS0);        // div 8
-    sei();
+    OLED_IRQ_RESTORE(sreg);
+#endif
 }
 
-uint8_t SSD1306_OLED_HW_I2C_LIB::usint2decascii(uint16_t num, char *buffer)      // convert integer to string
-{
-// @author	Neven Boyanov
-// NOTE: This implementation is borrowed from the LCDDDD library.
-// Original source code at: https://bitbucket.org/boyanov/avr/src/default/lcdddd/src/lcdddd/lcdddd.h
-
-	const unsigned short powers[] = { 10000u, 1000u, 100u, 10u, 1u }; // The "const unsigned short" combination gives shortest code.
-	char digit; // "digit" is stored in a char array, so it should be of type char.
-	uint8_t digits = USINT2DECASCII_MAX_DIGITS - 1;
-	for (uint8_t pos = 0; pos < 5; pos++) // "pos" is index in array, so should be of type int.
-	{
-		digit = 0;
-		while (num >= powers[pos])
-		{
-			digit++;
-			num -= powers[pos];
-		}
-		// ---- CHOOSE (1), (2) or (3) ----
-		// CHOICE (1) Fixed width, zero padded result.
-		/*
-		//buffer[pos] = digit + '0';	// Convert to ASCII
-		*/
-		// CHOICE (2) Fixed width, zero padded result, digits offset.
-		/*
-		buffer[pos] = digit + '0';	// Convert to ASCII
-		// Note: Determines the offset of the first significant digit.
-		if (digits == -1 && digit != 0) digits = pos;
-		// Note: Could be used for variable width, not padded, left aligned result.
-		*/
-		// CHOICE (3) Fixed width, space (or anything else) padded result, digits offset.
-		// Note: Determines the offset of the first significant digit.
-		// Note: Could be used for variable width, not padded, left aligned result.
-		if (digits == USINT2DECASCII_MAX_DIGITS - 1)
-		{
-			if (digit == 0)
-			{
-				if (pos < USINT2DECASCII_MAX_DIGITS - 1)	// Check position, so single "0" will be handled properly.
-					digit = -16;	// Use: "-16" for space (' '), "-3" for dash/minus ('-'), "0" for zero ('0'), etc. ...
-			}
-			else
-			{
-				digits = pos;
-			}
-		}
-		buffer[pos] = digit + '0';	// Convert to ASCII
-	}
-	// NOTE: The resulting ascii text should not be terminated with '\0' here.
-	//       The provided buffer maybe part of a larger text in both directions.
-	return digits;
-}
-
-
-void SSD1306_OLED_HW_I2C_LIB::D_ERROR(void) {                            // I2C comm error handler. Blinks ERROR_PIN in PORTD
-    for (uint8_t i = 0; i < 10; i++) {
-        PORTD ^= 1 << ERROR_PIN;
-        _delay_ms(300);
-    }
-}
-
-
-void SSD1306_OLED_HW_I2C_LIB::D_START_CMD(void) {                        // Start I2C and tell the display to await commands
-    cli();                                      // disable interrupts for the time being
-    //CLK_DIV_1();                                // increase clock speed to max
-    TWCR = (1<<TWINT)|(1<<TWSTA)|(1<<TWEN);     // START I2C
-    while (!(TWCR&(1<<TWINT)));                 // wait
-    if ((TWSR & 0xF8) != 0x08) D_ERROR();       // success or error
+// I2C bit rate
+// SCL = CLK / (16 + 2 * TWBR * prescaler), where CLK is F_CPU after the system clock prescaler (CLKPR)
+// and the TWI prescaler is 1, 4, 16 or 64 (TWSR bits 0-1).
+// Over Wire the rate goes to Wire.setClock(), over SPI it is the SPI clock; both are kept in bus_hz.
 
+#if (OLED_TRANSPORT == OLED_TRANSPORT_WIRE) || (OLED_TRANSPORT == OLED_TRANSPORT_SPI)
 
-    TWDR = SLA_W;                               // slave address
-    TWCR = (1<<TWINT) |(1<<TWEN);               // transmit
-    while (!(TWCR & (1<<TWINT)));               // wait for transmission
-    if ((TWSR & 0xF8) != 0x18) D_ERROR();       // success or error
+uint32_t SSD1306_OLED_HW_I2C_LIB::bus_hz = (OLED_TRANSPORT == OLED_TRANSPORT_SPI) ? OLED_SPI_CLOCK : 100000;
 
-    D_TX(0x00);                                 // prep command stream: C0=0 D/C#=0, followed by 6 zeros (datasheet 8.1.5.2)
+uint32_t SSD1306_OLED_HW_I2C_LIB::D_SET_CLOCK(uint32_t scl_hz) {
+    if (scl_hz == 0) return bus_hz;                                     // 0 = keep the clock
+    bus_hz = scl_hz;
+#if OLED_TRANSPORT == OLED_TRANSPORT_WIRE
+    Wire.setClock(scl_hz);
+#endif
+    return scl_hz;
 }
 
-void SSD1306_OLED_HW_I2C_LIB::D_START_DAT(void) {                        // Start I2C and tell the display to await data (pixels)
-    cli();                                      // disable interrupts for the time being
-    //CLK_DIV_1();                                // increase clock speed to max
-    TWCR = (1<<TWINT)|(1<<TWSTA)|(1<<TWEN);     // START I2C
-    while (!(TWCR&(1<<TWINT)));                 // wait
-    if ((TWSR & 0xF8) != 0x08) D_ERROR();       // success or error
+uint32_t SSD1306_OLED_HW_I2C_LIB::D_GET_CLOCK(void) {
+    return bus_hz;
+}
 
-    TWDR = SLA_W;                               // slave address
-    TWCR = (1<<TWINT) |(1<<TWEN);               // transmit
-    while (!(TWCR & (1<<TWINT)));               // wait for transmission
-    if ((TWSR & 0xF8) != 0x18) D_ERROR();       // success or error
+#else
 
-    D_TX(0x40);                                 // prep for data stream: C0 = 0 D/C#=1, followed by 6 zeros (datasheet 8.1.5.2)
+uint32_t SSD1306_OLED_HW_I2C_LIB::D_SET_CLOCK(uint32_t scl_hz) {        // set the SCL frequency (rounded down), returns the actual one
+    if (scl_hz == 0) return D_GET_CLOCK();                              // 0 = keep the clock
+    uint32_t clk = F_CPU >> (CLKPR & 0x0F);
+    uint32_t div = (clk + scl_hz - 1) / scl_hz;                         // CLK / SCL, rounded up
+    uint32_t twbr = (div > 16) ? (div - 16 + 1) / 2 : 0;
+    uint8_t prescaler = 0;
+    while (twbr > 255 && prescaler < 3) {                               // too slow for TWBR alone: raise the prescaler
+        twbr = (twbr + 3) / 4;
+        prescaler++;
+    }
+    if (twbr > 255) twbr = 255;
+    TWSR = prescaler;
+    TWBR = twbr;
+    return D_GET_CLOCK();
 }
 
-void SSD1306_OLED_HW_I2C_LIB::D_TX(uint8_t DATA) {                       // transmit 1 byte
-    TWDR = DATA;                                // data to transmit
-    TWCR = (1<<TWINT) |(1<<TWEN);               // transmit
-    while (!(TWCR & (1<<TWINT)));               // wait for transmission
-    if ((TWSR & 0xF8) != 0x28) D_ERROR();       // success or error
+uint32_t SSD1306_OLED_HW_I2C_LIB::D_GET_CLOCK(void) {                   // current SCL frequency in Hz
+    uint32_t clk = F_CPU >> (CLKPR & 0x0F);
+    return clk / (16 + 2UL * TWBR * (1 << (2 * (TWSR & 0x03))));
 }
 
-void SSD1306_OLED_HW_I2C_LIB::D_STOP (void) {                            // Stop I2C communication
-    TWCR = (1<<TWINT)|(1<<TWEN)|(1<<TWSTO);     // stop
-    //CLK_DIV_8();                                // decrease CLK speed
-    sei();                                      // re-enable interrupts
+#endif
+
+// Find the fastest SCL frequency the display keeps up with: starting at min_hz, the bit rate is raised
+// in ~25% steps up to max_hz, checking at each step that every byte of a few test transactions is ACKed.
+// The last rate that passed is kept and returned (0 if even min_hz failed; min_hz is then left set).
+uint32_t SSD1306_OLED_HW_I2C_LIB::D_TUNE_CLOCK(uint32_t min_hz, uint32_t max_hz) {
+    D_BATCH_BREAK();                                                    // no transaction may stay open across a rate change:
+    uint8_t in_batch = batch;                                           // the probes go out in transactions of their own
+    batch = 0;
+    D_CLAIM();                                                          // another display's open batch is closed
+    D_WAIT();                                                           // the bus must be idle (async mode)
+    if (min_hz == 0) min_hz = 1;
+    uint32_t good = 0;
+    uint32_t target = min_hz;
+    uint32_t last = 0;
+    for (;;) {
+        uint32_t actual = D_SET_CLOCK(target);
+        if (actual != last) {                                           // skip targets that map to the same divider
+            if (!D_PROBE()) break;
+            good = target;
+            last = actual;
+        }
+        if (target >= max_hz) break;
+        target += (target < 4) ? 1 : target / 4;
+        if (target > max_hz) target = max_hz;
+    }
+    batch = in_batch;
+    if (good) return D_SET_CLOCK(good);
+    D_SET_CLOCK(min_hz);
+    return 0;
+}
+
+static void probe_quiet(uint8_t status) {                               // error handler while probing: a failing rate is expected
+    (void)status;
+}
+
+uint8_t SSD1306_OLED_HW_I2C_LIB::D_PROBE(void) {                          // 1 if the display ACKs test transactions at the current rate
+    void (*handler)(uint8_t status) = error_handler;
+    uint8_t saved_status = last_status;
+    uint8_t saved_retries = retries;
+    error_handler = probe_quiet;                                        // no error LED, and no retries that hide a failure
+    last_status = OLED_OK;
+    retries = 0;
+    for (uint8_t n = 0; n < 4 && last_status == OLED_OK; n++) {        // the transaction layer: mux channel first, async: queued
+        D_START_CMD();                                                  // command stream
+        for (uint8_t i = 0; i < 16; i++) D_TX(0xE3);                    // NOP
+        D_STOP();
+    }
+    D_WAIT();                                                           // async: sent, and its errors reported
+    uint8_t status = last_status;
+    error_handler = handler;
+    last_status = saved_status;
+    retries = saved_retries;
+    if (status == OLED_ERR_TIMEOUT) D_BUS_RECOVER();
+    return status == OLED_OK;
 }
 
+// Bus statistics
+// Counted where the bus is driven: the BUS_* primitives in blocking mode, the ISR in async mode.
 
-// 
+#if OLED_STATS
+#define STAT_ADD(field, n)              (stats.field += (n))
+OLED_BUS_STATS SSD1306_OLED_HW_I2C_LIB::stats;
+#ifdef OLED_STATS_CLOCK
+uint16_t SSD1306_OLED_HW_I2C_LIB::irq_off_since;
+#endif
+#else
+#define STAT_ADD(field, n)              ((void)0)
+#endif
 
-void SSD1306_OLED_HW_I2C_LIB::D_INIT(void) {                             // Initialize display
-    D_START_CMD();
-    for (uint8_t i = 0; i < sizeof (init_sequence); i++) {
-        D_TX(pgm_read_byte(&init_sequence[i]));}            // read init sequence from progmem
-    D_TX(OLED_CMD_SET_COLUMN_RANGE);
-    D_TX(0x00);
-    D_TX(0x7F);
-    D_TX(OLED_CMD_SET_PAGE_RANGE);
-    D_TX(0);
-    D_TX(0x07);
-    D_STOP();
+void SSD1306_OLED_HW_I2C_LIB::D_GET_STATS(OLED_BUS_STATS *out) {
+#if OLED_STATS
+    uint8_t sreg;
+    OLED_IRQ_SAVE(sreg);                                                // the ISR updates the counters
+    *out = stats;
+    OLED_IRQ_RESTORE(sreg);
+#else
+    memset(out, 0, sizeof(*out));
+#endif
 }
 
+void SSD1306_OLED_HW_I2C_LIB::D_RESET_STATS(void) {
+#if OLED_STATS
+    uint8_t sreg;
+    OLED_IRQ_SAVE(sreg);
+    memset(&stats, 0, sizeof(stats));
+    OLED_IRQ_RESTORE(sreg);
+#endif
+}
 
-void SSD1306_OLED_HW_I2C_LIB::D_SETPOS(uint8_t x, uint8_t y) {           // Set cursor position
-    D_START_CMD();
-	D_TX(0xB0 + y);
-	D_TX(((x & 0xF0) >> 4) | 0x10);
-    D_TX((x & 0x0f));
-	D_STOP();
+// Bus transport
+// The blocking transaction layer and D_MUX_TX go through a few primitives:
+//   BUS_INIT()                     set the bus up (D_INIT)
+//   BUS_START(address, repeated)   (repeated) START and the slave address, OLED_OK if ACKed
+//   BUS_WRITE(data)                one byte, OLED_OK if ACKed
+//   BUS_WRITE_BLOCK(src, count)    'count' bytes from SRAM (framebuffer pages, RAM bitmaps)
+//   BUS_STOP()                     STOP, OLED_OK unless a buffered transport only finds out about an error now
+// OLED_TRANSPORT picks their implementation: the TWI registers, the Wire or SPI library, or the SSD1306
+// emulator of SSD1306_OLED_HOST.h when the library is compiled on a PC. The first byte after the address is
+// always a control byte, as on I2C. Async mode drives the TWI from its ISR and has no other transport.
+
+#if OLED_TRANSPORT == OLED_TRANSPORT_TWI
+
+uint8_t SSD1306_OLED_HW_I2C_LIB::D_TWI_STEP(uint8_t control, uint8_t expect, uint8_t error) {   // polled TWI step with timeout
+#if OLED_STATS && defined(OLED_STATS_CLOCK)
+    uint16_t t0 = OLED_STATS_CLOCK();
+#endif
+    TWCR = control;
+    uint16_t spin = 0;
+    while (!(TWCR & (1<<TWINT)) && spin < OLED_TWI_TIMEOUT) spin++;
+    STAT_ADD(wait_polls, spin);
+#if OLED_STATS && defined(OLED_STATS_CLOCK)
+    stats.wait_time += (uint16_t)(OLED_STATS_CLOCK() - t0);
+#endif
+    if (!(TWCR & (1<<TWINT))) {
+        STAT_ADD(timeouts, 1);
+        return OLED_ERR_TIMEOUT;
+    }
+    return ((TWSR & 0xF8) == expect) ? OLED_OK : error;
 }
 
-void SSD1306_OLED_HW_I2C_LIB::D_CLEAR(void) {                            // clear display
-    D_SETPOS(0, 0);
-    D_START_DAT();
-    for (uint16_t i = 0; i < 128 * 8; i++) {
-        D_TX(0);
+uint8_t SSD1306_OLED_HW_I2C_LIB::BUS_START(uint8_t address, uint8_t repeated) {
+    uint8_t status = D_TWI_STEP((1<<TWINT)|(1<<TWSTA)|(1<<TWEN), repeated ? 0x10 : 0x08, OLED_ERR_START);  // (repeated) START I2C
+    if (status != OLED_OK) return status;
+    STAT_ADD(transactions, 1);
+    TWDR = address;                                                     // slave address
+    status = D_TWI_STEP((1<<TWINT)|(1<<TWEN), 0x18, OLED_ERR_ADDR);
+    if (status == OLED_ERR_ADDR) STAT_ADD(nacks, 1);
+    return status;
+}
+
+uint8_t SSD1306_OLED_HW_I2C_LIB::BUS_WRITE(uint8_t data) {
+    TWDR = data;
+    uint8_t status = D_TWI_STEP((1<<TWINT)|(1<<TWEN), 0x28, OLED_ERR_DATA);
+#if OLED_STATS
+    if (status == OLED_OK) stats.bytes++;
+    else if (status == OLED_ERR_DATA) stats.nacks++;
+#endif
+    return status;
+}
+
+uint8_t SSD1306_OLED_HW_I2C_LIB::BUS_WRITE_BLOCK(const uint8_t *src, uint16_t count) {
+    uint8_t status = OLED_OK;
+    for (; count && status == OLED_OK; count--) status = BUS_WRITE(*src++);
+    return status;
+}
+
+uint8_t SSD1306_OLED_HW_I2C_LIB::BUS_STOP(void) {
+    TWCR = (1<<TWINT)|(1<<TWEN)|(1<<TWSTO);
+    for (uint16_t spin = 0; (TWCR & (1<<TWSTO)) && spin < OLED_TWI_TIMEOUT; spin++);   // let the STOP complete
+    return OLED_OK;
+}
+
+void SSD1306_OLED_HW_I2C_LIB::BUS_INIT(void) {
+    if (TWBR == 0) {                                                    // reset value: nobody has set up the bus yet
+        // SCL bit rate = CLK / (16 + 2*TWBR*[TWSR prescaler])
+        TWSR = 0x00;                                                    // I2C prescaler 1
+        TWBR = 2;                                                       // I2C divider 2
     }
-    D_STOP();
+}
 
+#elif OLED_TRANSPORT == OLED_TRANSPORT_HOST
+
+uint8_t SSD1306_OLED_HW_I2C_LIB::BUS_START(uint8_t address, uint8_t repeated) {
+    (void)repeated;
+    STAT_ADD(transactions, 1);
+    if (oled_host_start(address)) return OLED_OK;
+    STAT_ADD(nacks, 1);
+    return OLED_ERR_ADDR;
 }
 
-void SSD1306_OLED_HW_I2C_LIB::D_ON(void) {                               // turn on display (wake up)
-    D_START_CMD();
-    D_TX(0xAF);
-    D_STOP();
+uint8_t SSD1306_OLED_HW_I2C_LIB::BUS_WRITE(uint8_t data) {
+    if (oled_host_write(data)) {
+        STAT_ADD(bytes, 1);
+        return OLED_OK;
+    }
+    STAT_ADD(nacks, 1);
+    return OLED_ERR_DATA;
 }
 
-void SSD1306_OLED_HW_I2C_LIB::D_OFF(void) {                              // turn off display (sleep)
-    D_START_CMD();
-    D_TX(0xAE);
-    D_STOP();
+uint8_t SSD1306_OLED_HW_I2C_LIB::BUS_WRITE_BLOCK(const uint8_t *src, uint16_t count) {
+    uint8_t status = OLED_OK;
+    for (; count && status == OLED_OK; count--) status = BUS_WRITE(*src++);
+    return status;
 }
 
-void SSD1306_OLED_HW_I2C_LIB::D_CONTRAST (uint8_t contrast) {           // change contrast (brightness)
-    D_START_CMD();
-    D_TX(0x81);                                // Set contrast control register
-    D_TX(contrast);                            // contrast 0-255
-    D_STOP();
+uint8_t SSD1306_OLED_HW_I2C_LIB::BUS_STOP(void) {
+    oled_host_stop();
+    return OLED_OK;
 }
 
-// Draw a horizontal line
-// Note: even though the line is 1px thick, it will affect 8 pixel rows
-void SSD1306_OLED_HW_I2C_LIB::D_DRAW_HOR(uint8_t xpos, uint8_t ypos, uint8_t length) {
-    uint8_t ypage = ypos / 8;                       // determine page (8 vertical pixels) from pixel position
-    uint8_t dot_byte = 1 << (ypos % 8);             // create a byte with a dot at the specified position within the page
-    D_SETPOS(xpos, ypage);
-    D_START_DAT();
-    for (uint8_t i = 0; i < length; i++) {
-        D_TX(dot_byte);
+void SSD1306_OLED_HW_I2C_LIB::BUS_INIT(void) {
+    if (TWBR == 0) {                                                    // same clock bookkeeping as the TWI
+        TWSR = 0x00;
+        TWBR = 2;
     }
-	D_STOP();
 }
 
-// Draw a vertical line
-void SSD1306_OLED_HW_I2C_LIB::D_DRAW_VERT(uint8_t xpos, uint8_t ypos, uint8_t length) {
-    uint8_t ypage_start = ypos / 8;                         // determine starting page from pixel position
-    uint8_t ypage_end = (ypos + length) / 8;                // determine last page from pixel position
-    uint8_t ypages_span = ypage_end - ypage_start;          // how many pages does the line span?
+#elif OLED_TRANSPORT == OLED_TRANSPORT_WIRE
 
-    uint8_t dot_byte_start = 0xFF << (ypos % 8);            // create a byte with dots to represent first page (a column of 8 pixels)
-    uint8_t dot_byte_end = 0XFF >> ((ypos+length) % 8);     // create a byte with dot to represent last page
-    
-    if (ypages_span == 0) {                                 // line is 8 pixels or shorter
-        D_SETPOS(xpos, ypage_start);
-        D_START_DAT();
-        D_TX(dot_byte_start&dot_byte_end);
-        D_STOP();
+// Wire buffers a transaction and sends it in endTransmission(), so ACKs are only known then: BUS_START
+// and BUS_WRITE report the errors of a part already sent, BUS_STOP those of the rest. A transaction longer
+// than OLED_WIRE_BUFFER is split; the next part repeats the last control byte, so a data stream goes on
+// where it left off (the controller keeps its RAM pointer and any half-received command between them).
+
+static uint8_t wire_open;                                               // a transaction is being buffered
+static uint8_t wire_address;                                            // its 7-bit address
+static uint8_t wire_len;                                                // bytes in the Wire buffer
+static uint8_t wire_control;                                            // last control byte
+static uint8_t wire_want_control;                                       // next byte is a control byte
+
+uint8_t SSD1306_OLED_HW_I2C_LIB::D_WIRE_STATUS(uint8_t result) {                            // endTransmission() result as OLED_*
+    STAT_ADD(transactions, 1);
+    if (result == 0) return OLED_OK;
+    if (result == 2 || result == 3) STAT_ADD(nacks, 1);
+    if (result == 2) return OLED_ERR_ADDR;
+    if (result == 5) return OLED_ERR_TIMEOUT;
+    return OLED_ERR_DATA;
+}
+
+uint8_t SSD1306_OLED_HW_I2C_LIB::BUS_START(uint8_t address, uint8_t repeated) {
+    uint8_t status = OLED_OK;
+    if (wire_open && repeated) status = D_WIRE_STATUS(Wire.endTransmission(false));  // send the open part, no STOP
+    wire_open = 1;
+    wire_address = address >> 1;
+    wire_len = 0;
+    wire_want_control = 1;
+    Wire.beginTransmission(wire_address);
+    return status;
+}
+
+uint8_t SSD1306_OLED_HW_I2C_LIB::BUS_WRITE(uint8_t data) {
+    if (wire_len >= OLED_WIRE_BUFFER) {                                 // buffer full: send it, go on in a new one
+        uint8_t status = D_WIRE_STATUS(Wire.endTransmission());
+        if (status != OLED_OK) return status;
+        Wire.beginTransmission(wire_address);
+        wire_len = 0;
+        if (!wire_want_control) {
+            Wire.write(wire_control);
+            wire_len++;
+        }
     }
-    else {                                                  // line is >8 pixels long
-        D_SETPOS(xpos, ypage_start);
-        D_START_DAT();
-        D_TX(dot_byte_start);                               // draw first 8 pixels (first page)
-        D_STOP();
-        
-        if (ypages_span > 1) {                              // if the line >16 pixels long, draw the intermediate pages
-            for (uint8_t i = ypage_start + 1; i < ypage_end; i++) {
-                D_SETPOS(xpos, i);
-                D_START_DAT();
-                D_TX(0xFF);
-                D_STOP();
-            }
+    if (wire_want_control) {
+        wire_control = data;
+        wire_want_control = 0;
+    } else if (wire_control & 0x80) {                                   // Co=1: a control byte after every byte
+        wire_want_control = 1;
+    }
+    Wire.write(data);
+    wire_len++;
+    STAT_ADD(bytes, 1);
+    return OLED_OK;
+}
+
+uint8_t SSD1306_OLED_HW_I2C_LIB::BUS_WRITE_BLOCK(const uint8_t *src, uint16_t count) {  // Wire's buffer already makes it a bulk write
+    uint8_t status = OLED_OK;
+    for (; count && status == OLED_OK; count--) status = BUS_WRITE(*src++);
+    return status;
+}
+
+uint8_t SSD1306_OLED_HW_I2C_LIB::BUS_STOP(void) {
+    if (!wire_open) return OLED_OK;
+    wire_open = 0;
+    return D_WIRE_STATUS(Wire.endTransmission());
+}
+
+void SSD1306_OLED_HW_I2C_LIB::BUS_INIT(void) {
+    static uint8_t started = 0;
+    if (started) return;                                                // Wire.begin() resets the clock on some cores
+    started = 1;
+    Wire.begin();
+}
+
+#elif OLED_TRANSPORT == OLED_TRANSPORT_SPI
+
+// 4-wire SPI has no address and no control bytes: D/C# tells commands from data. The I2C framing the
+// library produces is translated here: the control byte sets the D/C# pin (and Co=1 makes the byte after
+// the next one a control byte again), the address phase and STOP select and release the chip.
+// Addresses are ignored, so there is one SPI display, on OLED_SPI_CS; D_SET_MUX has no effect.
+
+static uint8_t spi_open;                                                // chip selected, SPI transaction begun
+static uint8_t spi_want_control;                                        // next byte is a control byte
+static uint8_t spi_co;                                                  // Co bit of the last control byte
+static uint8_t spi_dc = 0xFF;                                           // D/C# pin level (0xFF = not set yet)
+
+uint8_t SSD1306_OLED_HW_I2C_LIB::BUS_START(uint8_t address, uint8_t repeated) {
+    (void)address;
+    (void)repeated;
+    if (!spi_open) {
+        SPI.beginTransaction(SPISettings(bus_hz, MSBFIRST, SPI_MODE0));
+        digitalWrite(OLED_SPI_CS, LOW);
+        spi_open = 1;
+        STAT_ADD(transactions, 1);
+    }
+    spi_want_control = 1;
+    return OLED_OK;
+}
+
+uint8_t SSD1306_OLED_HW_I2C_LIB::BUS_WRITE(uint8_t data) {
+    if (spi_want_control) {
+        uint8_t dc = (data >> 6) & 1;
+        if (dc != spi_dc) {
+            digitalWrite(OLED_SPI_DC, dc ? HIGH : LOW);
+            spi_dc = dc;
         }
-        D_SETPOS(xpos, ypage_end);
-        D_START_DAT();
-        D_TX(dot_byte_end);                                 // draw the last 8 pixels (last page)
-        D_STOP();
+        spi_co = data & 0x80;
+        spi_want_control = 0;
+        return OLED_OK;
+    }
+    SPI.transfer(data);
+    if (spi_co) spi_want_control = 1;
+    STAT_ADD(bytes, 1);
+    return OLED_OK;
+}
+
+uint8_t SSD1306_OLED_HW_I2C_LIB::BUS_WRITE_BLOCK(const uint8_t *src, uint16_t count) {
+    if (spi_want_control || spi_co || !count) {                         // not a plain stream: byte by byte
+        for (; count; count--) BUS_WRITE(*src++);
+        return OLED_OK;
     }
+#ifdef OLED_SPI_WRITE_BLOCK
+    OLED_SPI_WRITE_BLOCK(src, count);
+#else
+    for (uint16_t i = 0; i < count; i++) SPI.transfer(src[i]);
+#endif
+    STAT_ADD(bytes, count);
+    return OLED_OK;
 }
 
+uint8_t SSD1306_OLED_HW_I2C_LIB::BUS_STOP(void) {
+    if (spi_open) {
+        digitalWrite(OLED_SPI_CS, HIGH);
+        SPI.endTransaction();
+        spi_open = 0;
+    }
+    return OLED_OK;
+}
 
-void SSD1306_OLED_HW_I2C_LIB::D_PRINT_CHAR(char ch) {                                // print 1 character
-	uint8_t c = ch - 32;
+void SSD1306_OLED_HW_I2C_LIB::BUS_INIT(void) {
+    static uint8_t started = 0;
+    if (!started) {
+        started = 1;
+        pinMode(OLED_SPI_CS, OUTPUT);
+        digitalWrite(OLED_SPI_CS, HIGH);
+        pinMode(OLED_SPI_DC, OUTPUT);
+        SPI.begin();
+    }
+#if OLED_SPI_RES >= 0
+    pinMode(OLED_SPI_RES, OUTPUT);                                      // hardware reset (at least 3 us low)
+    digitalWrite(OLED_SPI_RES, LOW);
+    delayMicroseconds(10);
+    digitalWrite(OLED_SPI_RES, HIGH);
+    delayMicroseconds(10);
+#endif
+}
+
+#else
+#error "Unknown OLED_TRANSPORT"
+#endif
+
+#if (OLED_TRANSPORT == OLED_TRANSPORT_TWI) && !defined(__AVR__)
+#error "OLED_TRANSPORT_TWI needs an AVR, use OLED_TRANSPORT_WIRE"
+#endif
+
+#if OLED_ASYNC && (OLED_TRANSPORT != OLED_TRANSPORT_TWI) && (OLED_TRANSPORT != OLED_TRANSPORT_HOST)
+#error "OLED_ASYNC needs OLED_TRANSPORT_TWI (or the emulator)"
+#endif
+
+// I2C error handling
+// Every TWI wait is bounded by OLED_TWI_TIMEOUT polls. A transaction that cannot be started is retried
+// (after clocking the bus free if it looks stuck), and once a transaction has failed the rest of its
+// bytes are dropped instead of each waiting for its own timeout. Errors go to the handler set with
+// D_ON_ERROR(); without one, ERROR_PIN on PORTD is switched on and left on.
+
+#if defined(__AVR_ATmega32U4__) || defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+#define OLED_SCL_DDR                    DDRD        // SCL = PD0, SDA = PD1
+#define OLED_SCL_PORT                   PORTD
+#define OLED_SCL_BIT                    0
+#define OLED_SDA_DDR                    DDRD
+#define OLED_SDA_PORT                   PORTD
+#define OLED_SDA_PIN                    PIND
+#define OLED_SDA_BIT                    1
+#else
+#define OLED_SCL_DDR                    DDRC        // SCL = PC5 (A5), SDA = PC4 (A4)
+#define OLED_SCL_PORT                   PORTC
+#define OLED_SCL_BIT                    5
+#define OLED_SDA_DDR                    DDRC
+#define OLED_SDA_PORT                   PORTC
+#define OLED_SDA_PIN                    PINC
+#define OLED_SDA_BIT                    4
+#endif
+
+uint8_t SSD1306_OLED_HW_I2C_LIB::retries = OLED_RETRIES;
+
+void SSD1306_OLED_HW_I2C_LIB::D_ERROR(uint8_t status) {                  // I2C comm error handler
+    last_status = status;
+    mux_sel_w = 0;                                                      // the mux may not have seen the last select
+    if (error_handler) error_handler(status);
+#if OLED_AVR_REGS
+    else PORTD |= 1 << ERROR_PIN;                                       // no handler: light the error LED
+#else
+    else {
+        pinMode(ERROR_PIN, OUTPUT);
+        digitalWrite(ERROR_PIN, HIGH);
+    }
+#endif
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_ON_ERROR(void (*handler)(uint8_t status)) {   // set the error handler (0 = error LED)
+    error_handler = handler;
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_ON_YIELD(void (*handler)(void), uint16_t bytes) {   // call handler every 'bytes' bytes (0 = never)
+    yield_handler = bytes ? handler : 0;
+    yield_every = bytes;
+    yield_left = bytes;
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_SET_RETRIES(uint8_t count) {             // how often a failed transaction start is retried
+    retries = count;
+}
+
+uint8_t SSD1306_OLED_HW_I2C_LIB::D_STATUS(void) {                        // last error since the previous call (OLED_OK if none)
+#if OLED_ASYNC
+    Q_REPORT();
+#endif
+    uint8_t status = last_status;
+    last_status = OLED_OK;
+    return status;
+}
+
+// Shared bus
+// All instances share the TWI module. Each transaction starts with D_CLAIM(): a batch another display still
+// holds open is closed first, and a display behind a TCA9548A multiplexer gets its channel selected with
+// a one-byte write to the mux when a different channel (or no channel yet) was selected last. Several
+// displays with the same address can so sit on different channels; displays outside the mux are unaffected.
+
+uint8_t SSD1306_OLED_HW_I2C_LIB::mux_sel_w = 0;
+uint8_t SSD1306_OLED_HW_I2C_LIB::mux_sel_mask = 0;
+SSD1306_OLED_HW_I2C_LIB *SSD1306_OLED_HW_I2C_LIB::displays = 0;
+SSD1306_OLED_HW_I2C_LIB *SSD1306_OLED_HW_I2C_LIB::flush_turn = 0;
+SSD1306_OLED_HW_I2C_LIB *SSD1306_OLED_HW_I2C_LIB::bus_owner = 0;
+
+#define MUX_STALE()                     (mux_w && (mux_w != mux_sel_w || mux_mask != mux_sel_mask))
+
+void SSD1306_OLED_HW_I2C_LIB::D_SET_MUX(uint8_t address, uint8_t channel) {  // mux address 0x70-0x77 (or 0xE0-0xEE), 0 = none
+#if OLED_TRANSPORT == OLED_TRANSPORT_SPI
+    (void)address;                                                      // no I2C mux on an SPI display
+    (void)channel;
+#else
+    mux_w = (address < 0x78) ? address << 1 : address;
+    mux_mask = 1 << (channel & 7);
+#endif
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_CLAIM(void) {                            // take the bus over from another display
+    SSD1306_OLED_HW_I2C_LIB *owner = bus_owner;
+    if (owner == this) return;
+    bus_owner = this;
+    if (owner && owner->batch_open != BATCH_NONE) {                     // its transaction is still open: end it
+        owner->D_BATCH_BREAK();                                         // (it claims the bus back for that)
+        bus_owner = this;
+    }
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_BUS_RECOVER(void) {                      // free a bus held low by a slave stuck mid-byte
+#if OLED_TRANSPORT == OLED_TRANSPORT_TWI
+    uint8_t scl = OLED_SCL_PORT & (1<<OLED_SCL_BIT);
+    uint8_t sda = OLED_SDA_PORT & (1<<OLED_SDA_BIT);
+    TWCR = 0;                                                           // take the pins back from the TWI module
+    OLED_SCL_PORT &= ~(1<<OLED_SCL_BIT);                                // pins are driven open-drain style:
+    OLED_SDA_PORT &= ~(1<<OLED_SDA_BIT);                                // output = low, input = released
+    for (uint8_t i = 0; i < 9 && !(OLED_SDA_PIN & (1<<OLED_SDA_BIT)); i++) {
+        OLED_SCL_DDR |= 1<<OLED_SCL_BIT;                                // clock pulses until the slave lets go of SDA
+        _delay_us(5);
+        OLED_SCL_DDR &= ~(1<<OLED_SCL_BIT);
+        _delay_us(5);
+    }
+    OLED_SDA_DDR |= 1<<OLED_SDA_BIT;                                    // STOP: SDA low -> high while SCL is high
+    _delay_us(5);
+    OLED_SDA_DDR &= ~(1<<OLED_SDA_BIT);
+    _delay_us(5);
+    OLED_SCL_PORT |= scl;                                               // restore the pull-up settings
+    OLED_SDA_PORT |= sda;
+    TWCR = (1<<TWEN);
+#endif
+}
+
+
+#if OLED_ASYNC
+
+// Async mode: the transaction primitives build frames in the ring buffer, TWI_vect sends them.
+// A frame is [length][address][control byte][payload...], where length counts the control byte and payload.
+// Frames with address bit 0 set send the control byte and then 'count' generated bytes:
+//   fill frame  [4][address | 1][count low][count high][value][control byte]       'count' copies of value
+//   block frame [3 + pointer size][address | 1][count low][count high][pointer][control byte]
+//               'count' bytes read from SRAM at the pointer, which must stay unchanged until sent
+// so a screen fill takes 6 bytes of queue and a framebuffer page no more than a command.
+// The producer (D_START_* / D_TX) fills a frame privately and publishes it by moving q_head in D_STOP;
+// the ISR only ever moves q_tail, so no locking is needed as long as the indices are single bytes.
+// A frame whose address is not ACKed is resent up to 'retries' times, other failures drop the frame.
+// Errors are recorded by the ISR and reported from the main program on the next D_* call.
+
+#if (OLED_QUEUE_SIZE < 8) || (OLED_QUEUE_SIZE > 256) || (OLED_QUEUE_SIZE & (OLED_QUEUE_SIZE - 1))
+#error "OLED_QUEUE_SIZE must be a power of 2 between 8 and 256"
+#endif
+
+#define Q_MASK                          (OLED_QUEUE_SIZE - 1)
+#define Q_FREE()                        ((uint8_t)(q_tail - q_wr - 1) & Q_MASK)     // room left for the frame being built
+#define Q_LENGTH()                      ((uint8_t)(q_wr - q_frame - 2) & Q_MASK)    // bytes in the frame being built
+
+volatile uint8_t SSD1306_OLED_HW_I2C_LIB::q_buf[OLED_QUEUE_SIZE];
+volatile uint8_t SSD1306_OLED_HW_I2C_LIB::q_head = 0;
+volatile uint8_t SSD1306_OLED_HW_I2C_LIB::q_tail = 0;
+volatile uint8_t SSD1306_OLED_HW_I2C_LIB::q_left = 0;
+volatile uint8_t SSD1306_OLED_HW_I2C_LIB::q_busy = 0;
+volatile uint8_t SSD1306_OLED_HW_I2C_LIB::q_start = 0;
+volatile uint8_t SSD1306_OLED_HW_I2C_LIB::q_tries = 0;
+volatile uint8_t SSD1306_OLED_HW_I2C_LIB::q_status = OLED_OK;
+volatile uint8_t SSD1306_OLED_HW_I2C_LIB::q_fill = 0;
+volatile uint16_t SSD1306_OLED_HW_I2C_LIB::q_repeat = 0;
+const uint8_t * volatile SSD1306_OLED_HW_I2C_LIB::q_src = 0;
+volatile uint8_t SSD1306_OLED_HW_I2C_LIB::q_ticks = 0;
+uint8_t SSD1306_OLED_HW_I2C_LIB::q_wr = 0;
+uint8_t SSD1306_OLED_HW_I2C_LIB::q_frame = 0;
+uint8_t SSD1306_OLED_HW_I2C_LIB::q_control = 0;
+uint8_t SSD1306_OLED_HW_I2C_LIB::q_seen = 0;
+uint16_t SSD1306_OLED_HW_I2C_LIB::q_spins = 0;
+
+ISR(TWI_vect) {
+    SSD1306_OLED_HW_I2C_LIB::D_TWI_ISR();
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_TWI_ISR(void) {                          // send the next byte of the queue
+    uint8_t address;
+    q_ticks++;
+    switch (TWSR & 0xF8) {
+        case 0x08:                                                      // START sent
+        case 0x10:                                                      // repeated START sent
+            STAT_ADD(transactions, 1);
+            q_start = q_tail;                                           // kept for a resend
+            q_left = q_buf[q_tail];                                     // length of the next frame
+            address = q_buf[(q_tail + 1) & Q_MASK];
+            q_tail = (q_tail + 2) & Q_MASK;
+            if (address & 1) {                                          // fill or block frame: control byte, then generated bytes
+                q_repeat = q_buf[q_tail] | (q_buf[(q_tail + 1) & Q_MASK] << 8);
+                q_tail = (q_tail + 2) & Q_MASK;
+                if (q_left == 4) {
+                    q_fill = q_buf[q_tail];
+                    q_src = 0;
+                } else {
+                    union { const uint8_t *p; uint8_t b[sizeof(const uint8_t *)]; } src;
+                    for (uint8_t i = 0; i < sizeof(src.b); i++) src.b[i] = q_buf[(q_tail + i) & Q_MASK];
+                    q_src = src.p;
+                }
+                q_tail = (q_tail + q_left - 3) & Q_MASK;
+                q_left = 1;
+            }
+            TWDR = address & 0xFE;                                      // slave address
+            TWCR = (1<<TWINT)|(1<<TWEN)|(1<<TWIE);
+            return;
+        case 0x28:                                                      // data ACKed
+            STAT_ADD(bytes, 1);
+            /* fall through */
+        case 0x18:                                                      // address ACKed
+            if (q_left) {
+                TWDR = q_buf[q_tail];
+                q_tail = (q_tail + 1) & Q_MASK;
+                q_left--;
+                TWCR = (1<<TWINT)|(1<<TWEN)|(1<<TWIE);
+                return;
+            }
+            if (q_repeat) {
+                TWDR = q_src ? *q_src++ : q_fill;
+                q_repeat--;
+                TWCR = (1<<TWINT)|(1<<TWEN)|(1<<TWIE);
+                return;
+            }
+            q_tries = 0;
+            if (q_tail != q_head) {                                     // frame done, more queued: repeated START
+                TWCR = (1<<TWINT)|(1<<TWSTA)|(1<<TWEN)|(1<<TWIE);
+                return;
+            }
+            break;
+        case 0x20:                                                      // address not ACKed: resend the frame
+            STAT_ADD(nacks, 1);
+            if (q_tries < retries) {
+                STAT_ADD(retries, 1);
+                q_tries++;
+                q_tail = q_start;
+                q_left = 0;
+                TWCR = (1<<TWINT)|(1<<TWSTO)|(1<<TWSTA)|(1<<TWEN)|(1<<TWIE);
+                return;
+            }
+            q_status = OLED_ERR_ADDR;
+            goto drop;
+        case 0x30:                                                      // data not ACKed
+            STAT_ADD(nacks, 1);
+            q_status = OLED_ERR_DATA;
+            goto drop;
+        default:                                                        // arbitration lost or bus error
+            q_status = OLED_ERR_START;
+        drop:                                                           // drop the rest of the frame
+            q_tries = 0;
+            q_tail = (q_tail + q_left) & Q_MASK;
+            q_left = 0;
+            q_repeat = 0;
+            if (q_tail != q_head) {                                     // STOP, then START the next frame
+                TWCR = (1<<TWINT)|(1<<TWSTO)|(1<<TWSTA)|(1<<TWEN)|(1<<TWIE);
+                return;
+            }
+            break;
+    }
+    TWCR = (1<<TWINT)|(1<<TWSTO)|(1<<TWEN);                             // queue empty: STOP and release the bus
+    q_busy = 0;
+}
+
+void SSD1306_OLED_HW_I2C_LIB::Q_SPIN(void) {                             // one poll while waiting for the ISR
+    STAT_ADD(wait_polls, 1);
+    if (q_ticks != q_seen) {                                            // progress: restart the timeout
+        q_seen = q_ticks;
+        q_spins = 0;
+        return;
+    }
+    if (++q_spins < OLED_TWI_TIMEOUT) return;
+    D_BUS_RECOVER();                                                    // no interrupt for too long: reset the bus
+    q_left = 0;                                                         // and give up on everything queued
+    q_repeat = 0;
+    q_tail = q_head;
+    q_busy = 0;
+    q_spins = 0;
+    q_status = OLED_ERR_TIMEOUT;
+    STAT_ADD(timeouts, 1);
+}
+
+uint8_t SSD1306_OLED_HW_I2C_LIB::Q_PENDING(uint8_t mark) {              // 1 while the byte before index 'mark' is still queued
+    uint8_t tail = q_tail;
+    return ((uint8_t)(mark - tail - 1) & Q_MASK) < ((uint8_t)(q_head - tail) & Q_MASK);
+}
+
+void SSD1306_OLED_HW_I2C_LIB::Q_REPORT(void) {                           // pass errors recorded by the ISR to D_ERROR
+    uint8_t status = q_status;
+    if (status != OLED_OK) {
+        q_status = OLED_OK;
+        D_ERROR(status);
+    }
+}
+
+void SSD1306_OLED_HW_I2C_LIB::Q_OPEN(uint8_t control) {                 // start building a frame
+    Q_REPORT();
+    while (Q_FREE() < 4) Q_SPIN();                                      // room for length, address, control and one byte
+    q_frame = q_wr;
+    q_wr = (q_wr + 1) & Q_MASK;
+    q_buf[q_wr] = sla_w;
+    q_wr = (q_wr + 1) & Q_MASK;
+    q_buf[q_wr] = control;
+    q_wr = (q_wr + 1) & Q_MASK;
+    q_control = control;
+}
+
+void SSD1306_OLED_HW_I2C_LIB::Q_CLOSE(void) {                           // publish the frame and kick the ISR
+    q_buf[q_frame] = Q_LENGTH();
+    q_head = q_wr;
+    if (!q_busy) {                                                      // the ISR has seen q_head if it is still running
+        for (uint16_t spin = 0; (TWCR & (1<<TWSTO)) && spin < OLED_TWI_TIMEOUT; spin++);   // let the previous STOP complete
+        q_busy = 1;
+        TWCR = (1<<TWINT)|(1<<TWSTA)|(1<<TWEN)|(1<<TWIE);               // START
+    }
+}
+
+void SSD1306_OLED_HW_I2C_LIB::Q_MUX(void) {                              // queue a mux channel select [1][mux address][mask]
+    Q_REPORT();
+    while (Q_FREE() < 3) Q_SPIN();
+    q_frame = q_wr;
+    q_wr = (q_wr + 1) & Q_MASK;
+    q_buf[q_wr] = mux_w;
+    q_wr = (q_wr + 1) & Q_MASK;
+    q_buf[q_wr] = mux_mask;
+    q_wr = (q_wr + 1) & Q_MASK;
+    Q_CLOSE();
+    mux_sel_w = mux_w;
+    mux_sel_mask = mux_mask;
+}
+
+uint8_t SSD1306_OLED_HW_I2C_LIB::D_START(uint8_t control) {              // queue a transaction starting with a control byte
+    D_CLAIM();
+    if (batch_open != BATCH_NONE) Q_CLOSE();                            // batch: publish the open frame, the ISR chains them
+    if (MUX_STALE()) Q_MUX();
+    if (control == 0x80) {                                              // Co=1 command prefix (batch): keep it in one frame
+        while (Q_FREE() < 2 * OLED_BATCH_MERGE + 4) Q_SPIN();
+        Q_OPEN(control);
+        q_control = 0x40;                                               // a split frame continues with data
+        return OLED_OK;
+    }
+    Q_OPEN(control);
+    return OLED_OK;
+}
+
+uint8_t SSD1306_OLED_HW_I2C_LIB::D_SEND(uint8_t DATA) {                  // queue 1 byte
+    if (Q_FREE() == 0 || Q_LENGTH() == 0xFF) {                          // frame would overflow the queue or its length byte:
+        Q_CLOSE();                                                      // send what we have and continue in a new frame
+        Q_OPEN(q_control);
+    }
+    q_buf[q_wr] = DATA;
+    q_wr = (q_wr + 1) & Q_MASK;
+    return OLED_OK;
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_SEND_BLOCK(const uint8_t *src, uint8_t count) {   // queue 'count' bytes
+    for (; count; count--) D_SEND(*src++);
+}
+
+void SSD1306_OLED_HW_I2C_LIB::Q_GENERATED(const uint8_t *header, uint8_t size) {  // queue a fill or block frame
+    D_ACTIVE();
+    D_BATCH_BREAK();                                                    // always a frame of its own
+    D_CLAIM();
+    if (MUX_STALE()) Q_MUX();
+    Q_REPORT();
+    while (Q_FREE() < size + 1) Q_SPIN();
+    q_frame = q_wr;
+    for (uint8_t i = 0; i < size; i++) {
+        q_wr = (q_wr + 1) & Q_MASK;
+        q_buf[q_wr] = header[i];
+    }
+    q_wr = (q_wr + 1) & Q_MASK;
+    Q_CLOSE();
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_TX_FILL(uint8_t data, uint16_t count) {  // data transaction of 'count' copies of one byte
+    if (count == 0) return;
+    uint8_t frame[5] = { (uint8_t)(sla_w | 1), (uint8_t)count, (uint8_t)(count >> 8), data, 0x40 };
+    Q_GENERATED(frame, sizeof(frame));
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_TX_BLOCK(const uint8_t *src, uint16_t count) {  // data transaction of 'count' bytes from SRAM
+    if (count == 0) return;
+    uint8_t frame[4 + sizeof(src)] = { (uint8_t)(sla_w | 1), (uint8_t)count, (uint8_t)(count >> 8) };
+    memcpy(&frame[3], &src, sizeof(src));                               // sent without copying: src must not change until D_WAIT()
+    frame[3 + sizeof(src)] = 0x40;
+    Q_GENERATED(frame, sizeof(frame));
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_END(void) {                              // end of transaction: hand it to the ISR
+    Q_CLOSE();
+}
+
+uint8_t SSD1306_OLED_HW_I2C_LIB::D_BUSY(void) {                          // 1 while queued transactions are being sent
+    Q_REPORT();
+    return q_busy;
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_WAIT(void) {                             // wait until the queue has drained
+    while (q_busy) Q_SPIN();
+    Q_REPORT();
+}
+
+// Same in idle sleep: the CPU stops between interrupts and the TWI interrupt wakes it up. The stall
+// timeout counts wake-ups, so it relies on another interrupt source (Arduino: timer 0) if the TWI hangs.
+void SSD1306_OLED_HW_I2C_LIB::D_SLEEP_WAIT(void) {
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    for (;;) {
+        cli();
+        if (!q_busy) break;
+        sleep_enable();
+        sei();                                                          // the instruction after SEI runs first:
+        sleep_cpu();                                                    // an interrupt cannot slip in before the sleep
+        sleep_disable();
+        Q_SPIN();
+    }
+    sei();
+    Q_REPORT();
+}
+
+#else
+
+uint8_t SSD1306_OLED_HW_I2C_LIB::D_START(uint8_t control) {              // Start I2C and send the control byte
+    //CLK_DIV_1();                                // increase clock speed to max
+    D_CLAIM();
+    uint8_t status;
+    uint8_t held = (batch_open != BATCH_NONE);  // batch: the bus is still ours, so this is a repeated START
+#if OLED_IRQ_OFF
+    if (!held) {
+        OLED_IRQ_SAVE(irq_sreg);                // interrupts off until D_END
+#if OLED_STATS && defined(OLED_STATS_CLOCK)
+        irq_off_since = OLED_STATS_CLOCK();
+#endif
+    }
+#endif
+    if (held && tx_status != OLED_OK) {         // unless the open transaction failed
+        BUS_STOP();
+        held = 0;
+    }
+    for (uint8_t attempt = 0; ; attempt++) {
+        status = (!held && MUX_STALE()) ? D_MUX_TX() : OLED_OK;                         // mux channel first
+        if (status == OLED_OK) status = BUS_START(sla_w, held);                         // (repeated) START, slave address
+        if (status == OLED_OK) status = BUS_WRITE(control);                             // control byte
+        if (status == OLED_OK || attempt >= retries) break;
+        BUS_STOP();                                                                     // stop and try again
+        held = 0;
+        STAT_ADD(retries, 1);
+        if (status != OLED_ERR_ADDR) D_BUS_RECOVER();                                   // bus stuck rather than display absent
+    }
+    tx_status = status;
+    if (status != OLED_OK) D_ERROR(status);
+    return status;
+}
+
+uint8_t SSD1306_OLED_HW_I2C_LIB::D_MUX_TX(void) {                       // select the mux channel (a transaction of its own)
+    uint8_t status = BUS_START(mux_w, 0);
+    if (status == OLED_OK) status = BUS_WRITE(mux_mask);                // channel bit
+    uint8_t stop = BUS_STOP();
+    if (status == OLED_OK) status = stop;
+    if (status == OLED_OK) {
+        mux_sel_w = mux_w;
+        mux_sel_mask = mux_mask;
+    }
+    return status;
+}
+
+uint8_t SSD1306_OLED_HW_I2C_LIB::D_SEND(uint8_t DATA) {                  // transmit 1 byte
+    if (tx_status != OLED_OK) return tx_status; // transaction already failed: skip the byte
+    tx_status = BUS_WRITE(DATA);                // data to transmit
+    if (tx_status != OLED_OK) D_ERROR(tx_status);
+    else D_YIELD_AFTER(1);
+    return tx_status;
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_SEND_BLOCK(const uint8_t *src, uint8_t count) {   // transmit 'count' bytes from SRAM
+    if (tx_status != OLED_OK) return;
+    tx_status = D_WRITE_BLOCK(src, count);
+    if (tx_status != OLED_OK) D_ERROR(tx_status);
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_TX_BLOCK(const uint8_t *src, uint16_t count) {  // data transaction of 'count' bytes from SRAM
     D_START_DAT();
-    D_TX(0x00);                                             // character leading 1 px space
-	for (uint8_t i = 0; i < 5; i++)
-    {
-		D_TX(pgm_read_byte(&D_FONT6x8[c * 5 + i]));
-	}
-	D_STOP();
+    if (tx_status == OLED_OK) {
+        tx_status = D_WRITE_BLOCK(src, count);
+        if (tx_status != OLED_OK) D_ERROR(tx_status);
+    }
+    D_STOP();
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_TX_FILL(uint8_t data, uint16_t count) {  // data transaction of 'count' copies of one byte
+    D_START_DAT();
+    for (; count && tx_status == OLED_OK; count--) {
+        tx_status = BUS_WRITE(data);
+        D_YIELD_AFTER(1);
+    }
+    if (tx_status != OLED_OK) D_ERROR(tx_status);
+    D_STOP();
+}
+
+// Yielding
+// D_ON_YIELD(handler, n) calls the handler after every n payload bytes, also in the middle of a
+// transaction: the bus is held (SCL low) meanwhile, so the handler must not use the display or its bus,
+// but it may poll a UART, feed a watchdog or run a short task. Block writes are split at those points.
+uint8_t SSD1306_OLED_HW_I2C_LIB::D_WRITE_BLOCK(const uint8_t *src, uint16_t count) {   // BUS_WRITE_BLOCK, yielding
+    while (count) {
+        uint16_t n = (yield_handler && yield_left < count) ? yield_left : count;
+        uint8_t status = BUS_WRITE_BLOCK(src, n);
+        if (status != OLED_OK) return status;
+        D_YIELD_AFTER(n);
+        src += n;
+        count -= n;
+    }
+    return OLED_OK;
 }
 
-void SSD1306_OLED_HW_I2C_LIB::D_PRINT_STR(char *s) {                                 // print string (char array)
-	while (*s) {
-		D_PRINT_CHAR(*s++);
-	}
+void SSD1306_OLED_HW_I2C_LIB::D_YIELD_AFTER(uint16_t bytes) {           // count sent bytes, call the handler when due
+    if (!yield_handler) return;
+    yield_left -= bytes;
+    if (yield_left) return;
+    yield_left = yield_every;
+    yield_handler();
 }
 
-void SSD1306_OLED_HW_I2C_LIB::D_PRINT_INT(uint16_t num) {                            // print integer variable
-	ssd1306_numdec_buffer[USINT2DECASCII_MAX_DIGITS] = '\0';   // Terminate the string.
-	uint8_t digits = usint2decascii(num, ssd1306_numdec_buffer);
-	D_PRINT_STR(ssd1306_numdec_buffer + digits);
+void SSD1306_OLED_HW_I2C_LIB::D_END(void) {                              // Stop I2C communication
+    uint8_t status = BUS_STOP();                // stop
+    if (status != OLED_OK && tx_status == OLED_OK) {                    // buffered transport: error found only now
+        tx_status = status;
+        D_ERROR(status);
+    }
+    //CLK_DIV_8();                                // decrease CLK speed
+#if OLED_IRQ_OFF
+#if OLED_STATS && defined(OLED_STATS_CLOCK)
+    stats.irq_off_time += (uint16_t)(OLED_STATS_CLOCK() - irq_off_since);
+#endif
+    OLED_IRQ_RESTORE(irq_sreg);                 // interrupts as they were before D_START
+#endif
+}
+
+
+uint8_t SSD1306_OLED_HW_I2C_LIB::D_BUSY(void) {                          // blocking mode: nothing is ever pending
+    return 0;
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_WAIT(void) {
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_SLEEP_WAIT(void) {
+}
+
+#endif
+
+
+// Transactions
+// Outside a batch every D_START_CMD / D_START_DAT ... D_STOP is one I2C transaction. Between D_BATCH_BEGIN()
+// and D_BATCH_END() the transaction is kept open instead: data that follows data continues the same data
+// stream, a new transaction begins with a repeated START instead of STOP + START, and a command run of up
+// to OLED_BATCH_MERGE bytes (a D_SETPOS) is held back and sent at the start of the next data transaction
+// with Co=1 control bytes (0x80 cmd 0x80 cmd ... 0x40 data...), which saves its address phase.
+// Longer command runs would cost more in prefixes than they save and get a transaction of their own.
+// With OLED_IRQ_OFF set, interrupts stay disabled until D_BATCH_END(), so keep batches short.
+// In async mode a Co=1 prefix must fit one frame, so queues of 16 bytes or less only chain the frames.
+
+#define BATCH_CAN_MERGE                 (!OLED_ASYNC || (OLED_QUEUE_SIZE > 2 * OLED_BATCH_MERGE + 4))
+
+uint8_t SSD1306_OLED_HW_I2C_LIB::D_START_CMD(void) {                     // Start I2C and tell the display to await commands
+    if (!batch) return D_START(0x00);           // prep command stream: C0=0 D/C#=0, followed by 6 zeros (datasheet 8.1.5.2)
+    if (batch_open != BATCH_CMD) batch_collect = 1;                     // hold the commands back (else: continue the stream)
+    return OLED_OK;
+}
+
+uint8_t SSD1306_OLED_HW_I2C_LIB::D_START_DAT(void) {                     // Start I2C and tell the display to await data (pixels)
+    D_ACTIVE();
+    if (!batch) return D_START(0x40);           // prep for data stream: C0 = 0 D/C#=1, followed by 6 zeros (datasheet 8.1.5.2)
+    batch_collect = 0;
+    if (batch_len && !BATCH_CAN_MERGE) D_BATCH_FLUSH();
+    if (batch_len) {                                                    // held-back commands go in front of the data
+        uint8_t status = D_START(0x80);                                 // C0=1 D/C#=0: one command byte follows
+        D_SEND(batch_cmd[0]);
+        for (uint8_t i = 1; i < batch_len; i++) {
+            D_SEND(0x80);
+            D_SEND(batch_cmd[i]);
+        }
+        D_SEND(0x40);                                                   // C0=0 D/C#=1: data until the end
+        batch_len = 0;
+        batch_open = BATCH_DATA;
+        return status;
+    }
+    if (batch_open == BATCH_DATA) return OLED_OK;                       // continue the open data stream
+    uint8_t status = D_START(0x40);
+    batch_open = BATCH_DATA;
+    return status;
+}
+
+uint8_t SSD1306_OLED_HW_I2C_LIB::D_TX(uint8_t DATA) {                    // transmit 1 byte
+    if (batch_collect) {
+        if (batch_len < OLED_BATCH_MERGE) {
+            batch_cmd[batch_len++] = DATA;
+            return OLED_OK;
+        }
+        D_BATCH_FLUSH();                                                // too long to merge
+    }
+    return D_SEND(DATA);
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_STOP (void) {                            // Stop I2C communication (batch: keep it open)
+    if (!batch) {
+        D_END();
+        return;
+    }
+    batch_collect = 0;
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_BATCH_FLUSH(void) {                      // send held-back commands in a command transaction
+    D_START(0x00);
+    for (uint8_t i = 0; i < batch_len; i++) {
+        D_SEND(batch_cmd[i]);
+    }
+    batch_len = 0;
+    batch_collect = 0;
+    batch_open = BATCH_CMD;
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_BATCH_BREAK(void) {                      // send everything held back and close the transaction
+    if (!batch) return;
+    if (batch_len) D_BATCH_FLUSH();
+    batch_collect = 0;
+    if (batch_open != BATCH_NONE) {
+        batch_open = BATCH_NONE;
+        D_END();
+    }
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_BATCH_BEGIN(void) {                      // keep one transaction open until D_BATCH_END()
+    if (batch) return;
+    batch = 1;
+    batch_open = BATCH_NONE;
+    batch_collect = 0;
+    batch_len = 0;
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_BATCH_END(void) {
+    D_BATCH_BREAK();
+    batch = 0;
+}
+
+
+void SSD1306_OLED_HW_I2C_LIB::D_INIT(void) {                             // Initialize display
+    BUS_INIT();
+    if (scl_init) D_SET_CLOCK(scl_init);
+#if OLED_FIXED_GEOMETRY && (OLED_INIT_PROFILE == OLED_PROFILE_SHORT)
+    const uint8_t *init_sequence = init_short;
+    uint8_t size = sizeof (init_short);
+#elif OLED_FIXED_GEOMETRY
+    const uint8_t *init_sequence = init_standard;
+    uint8_t size = sizeof (init_standard);
+#else
+    const uint8_t *init_sequence = (init_profile == OLED_PROFILE_SHORT) ? init_short : init_standard;
+    uint8_t size = (init_profile == OLED_PROFILE_SHORT) ? sizeof (init_short) : sizeof (init_standard);
+#endif
+    D_START_CMD();
+    for (uint8_t i = 0; i < size; i++) {
+        D_TX(pgm_read_byte(&init_sequence[i]));}            // read init sequence from progmem
+    D_TX_GEOMETRY(1);
+    D_TX_RANGE(0, disp_width - 1, 0, disp_pages - 1);
+    D_TX(0xAF);                                                         // Display ON in normal mode
+    D_STOP();
+    contrast = 0x00;                                                    // as set by init_sequence
+    start_line = 0;
+    power_state = OLED_POWER_ON;
+    idle_busy = 1;
+}
+
+// Fast re-initialization: reset-value registers are not sent (see reinit_sequence), the contrast is the one
+// last set by D_CONTRAST, and the display stays off until the framebuffer (if any) has been sent again, so
+// the old picture comes back at once. GDDRAM may have been lost: in direct mode the caller has to redraw.
+void SSD1306_OLED_HW_I2C_LIB::D_REINIT_FAST(void) {
+    D_START_CMD();
+    D_TX(0xAE);
+    for (uint8_t i = 0; i < sizeof (reinit_sequence); i++) {
+        D_TX(pgm_read_byte(&reinit_sequence[i]));
+    }
+    D_TX_GEOMETRY(0);
+    D_TX(0x81);
+    D_TX(contrast);
+    D_TX(0x40 | start_line);                                            // console / page flip position
+    D_TX_RANGE(0, disp_width - 1, 0, disp_pages - 1);
+    D_STOP();
+    pos_lost = 1;
+#if OLED_FRAMEBUFFER
+    FB_RESEND();
+#else
+    win_full = 1;
+#endif
+    D_START_CMD();
+    D_TX(0xAF);
+    D_STOP();
+    power_state = OLED_POWER_ON;
+    idle_busy = 1;
+}
+
+// Geometry and profile registers of this instance (inside a command transaction).
+// all = 0: only those that differ from the reset value (D_REINIT_FAST).
+void SSD1306_OLED_HW_I2C_LIB::D_TX_GEOMETRY(uint8_t all) {
+#ifdef OLED_OSC
+    uint8_t osc = OLED_OSC;
+#else
+    uint8_t osc = (init_profile == OLED_PROFILE_SHORT) ? 0x80 : 0xF0;   // clock divide / oscillator
+#endif
+#ifdef OLED_VCOMH
+    uint8_t vcomh = OLED_VCOMH;
+#else
+    uint8_t vcomh = (init_profile == OLED_PROFILE_SHORT) ? 0x30 : 0x20; // 0x20 = 0.77 x VCC
+#endif
+#ifdef OLED_COM_PINS
+    uint8_t com_pins = OLED_COM_PINS;
+#else
+    uint8_t com_pins = (disp_height == 64 || disp_height == 48) ? 0x12 : 0x02;   // alternative / sequential COM
+#endif
+    if (all || disp_height != 64) {
+        D_TX(0xA8);                                                     // multiplex ratio (reset: 63)
+        D_TX(disp_height - 1);
+    }
+    if (all || osc != 0x80) {
+        D_TX(0xD5);                                                     // oscillator (reset: 0x80)
+        D_TX(osc);
+    }
+    if (all || com_pins != 0x12) {
+        D_TX(0xDA);                                                     // COM pins (reset: 0x12)
+        D_TX(com_pins);
+    }
+    if (all || vcomh != 0x20) {
+        D_TX(0xDB);                                                     // V_COMH (reset: 0x20)
+        D_TX(vcomh);
+    }
+}
+
+// Column and page range commands for a window in screen coordinates (inside a command transaction)
+void SSD1306_OLED_HW_I2C_LIB::D_TX_RANGE(uint8_t x0, uint8_t x1, uint8_t p0, uint8_t p1) {
+    D_TX(OLED_CMD_SET_COLUMN_RANGE);
+    D_TX(x0 + col_offset);
+    D_TX(x1 + col_offset);
+    D_TX(OLED_CMD_SET_PAGE_RANGE);
+    D_TX(p0);
+    D_TX(p1);
+}
+
+
+#if OLED_DOUBLE_BUFFER && !OLED_FRAMEBUFFER
+#error "OLED_DOUBLE_BUFFER needs OLED_FRAMEBUFFER"
+#endif
+
+#if OLED_FRAMEBUFFER
+
+// Framebuffer mode: drawing and text go to fb[], a RAM copy of GDDRAM laid out the same way
+// (OLED_WIDTH columns x OLED_PAGES pages, one byte = 8 vertical pixels). Each page keeps the range of columns
+// changed since the last D_FLUSH(), and D_FLUSH() sends only those spans. fb[] is shown from row 0: a start
+// line moved with D_START_LINE() is put back by the next D_FLUSH() (page flipping sets its own).
+
+void SSD1306_OLED_HW_I2C_LIB::FB_MARK(uint8_t x, uint8_t page) {         // add a column to the dirty span of a page
+    if (x < dirty_lo[page]) dirty_lo[page] = x;
+    if (x > dirty_hi[page]) dirty_hi[page] = x;
+}
+
+void SSD1306_OLED_HW_I2C_LIB::FB_PUT(uint8_t data) {                     // write a byte at the RAM pointer and advance it
+    fb[fb_page * disp_width + fb_x] = data;                                    // the way the controller does in horizontal mode
+    FB_MARK(fb_x, fb_page);
+    if (++fb_x > fb_x1) {
+        fb_x = fb_x0;
+        if (++fb_page > fb_p1) fb_page = fb_p0;
+    }
+}
+
+void SSD1306_OLED_HW_I2C_LIB::FB_DRAW(uint8_t x, uint8_t page, uint8_t bits) {  // change pixels without touching the others
+    if (x >= disp_width || page >= disp_pages || !bits) return;
+    uint8_t *p = &fb[page * disp_width + x];
+    uint8_t old = *p;
+    if (draw_mode == OLED_DRAW_SET) *p |= bits;
+    else if (draw_mode == OLED_DRAW_CLEAR) *p &= ~bits;
+    else *p ^= bits;
+    if (*p != old) FB_MARK(x, page);                                    // only columns that really change are sent
+}
+
+#if OLED_DOUBLE_BUFFER
+
+#if OLED_PAGE_FLIP && (OLED_HEIGHT > 32)
+#error "OLED_PAGE_FLIP needs a panel of at most 32 rows"
+#endif
+
+void SSD1306_OLED_HW_I2C_LIB::D_FLUSH(void) {                            // double buffering: flushing is swapping
+    D_SWAP();
+}
+
+void SSD1306_OLED_HW_I2C_LIB::FB_RESEND(void) {                          // GDDRAM lost: send the front buffer again
+    D_WAIT();
+    if (!fb_sent) return;                                               // nothing shown yet
+#if OLED_PAGE_FLIP
+    uint8_t p0 = fb_half * disp_pages;                                  // to the half being shown
+    memset(last_lo, 0, sizeof(last_lo));                                // the other half: resent by the next swap
+    memset(last_hi, disp_width - 1, sizeof(last_hi));
+#else
+    uint8_t p0 = 0;
+#endif
+    D_START_CMD();
+    D_TX_RANGE(0, disp_width - 1, p0, p0 + disp_pages - 1);
+    D_STOP();
+    D_TX_BLOCK(fb_front, disp_width * disp_pages);
+}
+
+uint8_t SSD1306_OLED_HW_I2C_LIB::D_FLUSH_PAGE(void) {                    // a frame is never sent in parts: swap if anything changed
+    for (uint8_t page = 0; page < disp_pages; page++) {
+        if (dirty_lo[page] <= dirty_hi[page]) {
+            D_SWAP();
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// The dirty span of each page is trimmed to the columns that really differ from the front buffer, so
+// redrawing a whole screen only sends what changed. With OLED_PAGE_FLIP the hidden half of GDDRAM still
+// holds the frame before the previous one, so the span sent there by the previous swap is added.
+void SSD1306_OLED_HW_I2C_LIB::D_SWAP(void) {
+    D_WAIT();                                                           // the old front buffer may still be on the bus
+    uint8_t *back = fb_front;
+    fb_front = fb;
+    fb = back;
+#if OLED_PAGE_FLIP
+    uint8_t half = fb_half ^ 1;                                         // write to the hidden half
+#else
+    uint8_t half = 0;
+#endif
+    for (uint8_t page = 0; page < disp_pages; page++) {
+        const uint8_t *now = &fb_front[page * disp_width];
+        const uint8_t *old = &back[page * disp_width];
+        uint8_t lo = dirty_lo[page];
+        uint8_t hi = dirty_hi[page];
+        if (fb_sent) {
+            while (lo <= hi && now[lo] == old[lo]) lo++;
+            if (lo <= hi) {
+                while (now[hi] == old[hi]) hi--;                        // stops at lo, which differs
+            }
+        }
+        if (lo > hi) {
+            lo = 0xFF;
+            hi = 0;
+        }
+        dirty_lo[page] = 0xFF;
+        dirty_hi[page] = 0;
+        uint8_t send_lo = lo, send_hi = hi;
+#if OLED_PAGE_FLIP
+        if (last_lo[page] < send_lo) send_lo = last_lo[page];
+        if (last_hi[page] > send_hi && last_lo[page] <= last_hi[page]) send_hi = last_hi[page];
+        last_lo[page] = lo;
+        last_hi[page] = hi;
+#endif
+        if (send_lo > send_hi) continue;                                // page is unchanged
+        D_START_CMD();
+        D_TX_RANGE(send_lo, send_hi, page + half * disp_pages, page + half * disp_pages);
+        D_STOP();
+        D_TX_BLOCK(&now[send_lo], send_hi - send_lo + 1);
+    }
+#if OLED_PAGE_FLIP
+    D_START_LINE(half * disp_height);                                   // show the new frame at once
+    fb_half = half;
+#else
+    if (start_line != 0) D_START_LINE(0);                               // fb[] is shown from row 0 (after D_START_LINE)
+#endif
+    memcpy(back, fb_front, disp_width * disp_pages);                    // keep drawing on a copy of the frame being sent
+    fb_sent = 1;
+}
+
+#else
+
+void SSD1306_OLED_HW_I2C_LIB::D_SWAP(void) {                             // single framebuffer: same as D_FLUSH
+    D_FLUSH();
+}
+
+void SSD1306_OLED_HW_I2C_LIB::FB_RESEND(void) {                          // GDDRAM lost: send all of fb[]
+    for (uint8_t page = 0; page < disp_pages; page++) {
+        dirty_lo[page] = 0;
+        dirty_hi[page] = disp_width - 1;
+    }
+    D_FLUSH();
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_FLUSH(void) {                            // send the changed spans of fb[] to the display
+    while (D_FLUSH_PAGE());
+}
+
+uint8_t SSD1306_OLED_HW_I2C_LIB::D_FLUSH_PAGE(void) {                    // send the next dirty page, 0 if all are clean
+    if (start_line != 0) {                                              // fb[] is shown from row 0 (after D_START_LINE)
+        D_START_LINE(0);
+        return 1;
+    }
+    for (uint8_t n = 0; n < disp_pages; n++) {
+        uint8_t page = flush_page;
+        flush_page = (page + 1 < disp_pages) ? page + 1 : 0;
+        uint8_t lo = dirty_lo[page];
+        uint8_t hi = dirty_hi[page];
+        if (lo > hi) continue;                                          // page is clean
+        D_START_CMD();
+        D_TX_RANGE(lo, hi, page, page);                                 // window = the dirty span of this page
+        D_STOP();
+        D_TX_BLOCK(&fb[page * disp_width + lo], hi - lo + 1);         // one bus block (async: sent from fb[], later changes are dirty again)
+        dirty_lo[page] = 0xFF;
+        dirty_hi[page] = 0;
+        return 1;
+    }
+    return 0;
+}
+
+#endif
+
+void SSD1306_OLED_HW_I2C_LIB::D_WINDOW(uint8_t x0, uint8_t x1, uint8_t p0, uint8_t p1) {    // limit the RAM pointer to a window
+    fb_x0 = x0;
+    fb_x1 = x1;
+    fb_p0 = p0;
+    fb_p1 = p1;
+    fb_x = x0;
+    fb_page = p0;
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_SETPOS(uint8_t x, uint8_t y) {           // Set cursor position (RAM pointer)
+    D_WINDOW(0, disp_width - 1, 0, disp_pages - 1);
+    fb_x = x % disp_width;
+    fb_page = y % disp_pages;
+    cur_x = fb_x;
+    cur_page = fb_page;
+    pos_lost = 0;
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_FILL(uint8_t pattern) {                  // fill the screen (on the next D_FLUSH)
+    memset(fb, pattern, disp_width * disp_pages);
+    for (uint8_t page = 0; page < disp_pages; page++) {
+        dirty_lo[page] = 0;
+        dirty_hi[page] = disp_width - 1;
+    }
+    D_WINDOW(0, disp_width - 1, 0, disp_pages - 1);
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_FILL_RECT(uint8_t xpos, uint8_t page, uint8_t width, uint8_t pages, uint8_t pattern) {
+    if (width == 0 || pages == 0 || xpos >= disp_width || page >= disp_pages) return;
+    uint8_t xlast = (xpos + width > disp_width) ? disp_width - 1 : xpos + width - 1;
+    uint8_t page_last = (page + pages > disp_pages) ? disp_pages - 1 : page + pages - 1;
+    for (uint8_t p = page; p <= page_last; p++) {
+        memset(&fb[p * disp_width + xpos], pattern, xlast - xpos + 1);
+        FB_MARK(xpos, p);
+        FB_MARK(xlast, p);
+    }
+}
+
+#else
+
+void SSD1306_OLED_HW_I2C_LIB::D_FLUSH(void) {                            // direct mode: everything has been sent already
+}
+
+uint8_t SSD1306_OLED_HW_I2C_LIB::D_FLUSH_PAGE(void) {
+    return 0;
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_SWAP(void) {
+}
+
+// Set the column/page window (horizontal addressing): the data that follows fills columns x0-x1
+// of page p0, then of the next page, and so on up to p1, all in one data transaction.
+void SSD1306_OLED_HW_I2C_LIB::D_WINDOW(uint8_t x0, uint8_t x1, uint8_t p0, uint8_t p1) {
+    D_START_CMD();
+    D_TX_RANGE(x0, x1, p0, p1);
+    D_STOP();
+    win_full = (x0 == 0 && x1 == disp_width - 1 && p0 == 0 && p1 == disp_pages - 1);
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_SETPOS(uint8_t x, uint8_t y) {           // Set cursor position
+    D_START_CMD();
+    if (!win_full) {                                    // a window is still set: restore the full screen range
+        D_TX_RANGE(0, disp_width - 1, 0, disp_pages - 1);
+        win_full = 1;
+    }
+    cur_x = x;
+    cur_page = y;
+    pos_lost = 0;
+    x += col_offset;
+	D_TX(0xB0 + y);
+	D_TX(((x & 0xF0) >> 4) | 0x10);
+    D_TX((x & 0x0f));
+	D_STOP();
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_FILL(uint8_t pattern) {                  // fill the screen with a byte pattern
+    D_WINDOW(0, disp_width - 1, 0, disp_pages - 1);
+    D_TX_FILL(pattern, disp_width * disp_pages);
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_FILL_RECT(uint8_t xpos, uint8_t page, uint8_t width, uint8_t pages, uint8_t pattern) {
+    if (width == 0 || pages == 0 || xpos >= disp_width || page >= disp_pages) return;
+    uint8_t xlast = (xpos + width > disp_width) ? disp_width - 1 : xpos + width - 1;
+    uint8_t page_last = (page + pages > disp_pages) ? disp_pages - 1 : page + pages - 1;
+    D_WINDOW(xpos, xlast, page, page_last);
+    D_TX_FILL(pattern, (uint16_t)(xlast - xpos + 1) * (page_last - page + 1));
+}
+
+#endif
+
+void SSD1306_OLED_HW_I2C_LIB::D_CLEAR(void) {                            // clear display
+    D_FILL(0x00);
+}
+
+// Several displays: D_FLUSH_STEP() sends one dirty page of the display after the one served last, so a
+// display with a lot to send holds the others up by one page at most. Call it from the main loop to spread
+// the work, or D_FLUSH_ALL() to send everything. Double-buffered displays are swapped whole in their turn.
+uint8_t SSD1306_OLED_HW_I2C_LIB::D_FLUSH_STEP(void) {
+    SSD1306_OLED_HW_I2C_LIB *lcd = flush_turn;
+    for (SSD1306_OLED_HW_I2C_LIB *n = displays; n; n = n->next_display) {     // once round the list at most
+        lcd = (lcd && lcd->next_display) ? lcd->next_display : displays;
+        if (lcd->D_FLUSH_PAGE()) {
+            flush_turn = lcd;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_FLUSH_ALL(void) {
+    while (D_FLUSH_STEP());
+}
+
+// Blank the panel without touching GDDRAM: OLED_BLANK_DARK switches the panel off (0xAE),
+// OLED_BLANK_LIT lights every pixel (0xA5), OLED_BLANK_OFF shows GDDRAM again.
+// Redrawing while blanked hides the transition and costs no pixel traffic for the blank itself.
+void SSD1306_OLED_HW_I2C_LIB::D_BLANK(uint8_t mode) {
+    D_START_CMD();
+    D_TX((mode == OLED_BLANK_LIT) ? 0xA5 : 0xA4);           // entire display on / follow GDDRAM
+    D_TX((mode == OLED_BLANK_DARK) ? 0xAE : 0xAF);          // display off / on
+    D_STOP();
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_ON(void) {                               // turn on display (wake up)
+    if (power_state != OLED_POWER_ON) {                                 // powered down by the idle manager
+        D_WAKE();
+        return;
+    }
+    D_START_CMD();
+    D_TX(0xAF);
+    D_STOP();
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_OFF(void) {                              // turn off display (sleep)
+    D_START_CMD();
+    D_TX(0xAE);
+    D_STOP();
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_CONTRAST (uint8_t contrast) {           // change contrast (brightness)
+    D_START_CMD();
+    D_TX(0x81);                                // Set contrast control register
+    D_TX(contrast);                            // contrast 0-255
+    D_STOP();
+    this->contrast = contrast;
+    idle_busy = 1;
+    if (power_state == OLED_POWER_DIM) power_state = OLED_POWER_ON;     // no longer dimmed
+}
+
+// Idle manager
+// D_IDLE_TICK(now) is called regularly with a running time (any unit, e.g. millis()). When no pixel data
+// has been sent for dim_after, the contrast is lowered to dim_contrast; after off_after the panel is
+// switched off (0xAE) and the charge pump disabled, which leaves a few uA. GDDRAM is kept, so the next
+// data sent (D_PRINT_*, D_DRAW_*, D_FLUSH, ...) first restores the charge pump, the panel and the contrast
+// with one command transaction, without D_INIT(). Other commands do not count as activity, except
+// D_CONTRAST (a new level, shown at once) and D_ON (same as D_WAKE).
+
+void SSD1306_OLED_HW_I2C_LIB::D_SET_IDLE(uint32_t dim_after, uint32_t off_after, uint8_t dim_contrast) {
+    idle_dim = dim_after;
+    idle_off = off_after;
+    idle_contrast = dim_contrast;
+    idle_busy = 1;                                                      // start timing from the next tick
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_IDLE_TICK(uint32_t now) {
+    if (idle_busy) {
+        idle_busy = 0;
+        idle_since = now;
+        return;
+    }
+    uint32_t idle = now - idle_since;                                   // wraps correctly
+    if (power_state == OLED_POWER_ON && idle_dim && idle >= idle_dim) {
+        D_START_CMD();
+        D_TX(0x81);
+        D_TX(idle_contrast);
+        D_STOP();
+        power_state = OLED_POWER_DIM;
+    }
+    if (power_state != OLED_POWER_OFF && idle_off && idle >= idle_off) {
+        D_START_CMD();
+        D_TX(0xAE);                                                     // panel off first, then its supply
+#if OLED_CHARGE_PUMP
+        D_TX(0x8D);
+        D_TX(0x10);
+#endif
+        D_STOP();
+        power_state = OLED_POWER_OFF;
+    }
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_WAKE(void) {
+    idle_busy = 1;
+    if (power_state == OLED_POWER_ON) return;
+    D_START_CMD();
+    if (power_state == OLED_POWER_OFF) {
+#if OLED_CHARGE_PUMP
+        D_TX(0x8D);
+        D_TX(0x14);
+#endif
+        D_TX(0xAF);
+    }
+    D_TX(0x81);
+    D_TX(contrast);
+    D_STOP();
+    power_state = OLED_POWER_ON;
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_ACTIVE(void) {                           // pixel data is about to be sent
+    idle_busy = 1;
+    if (power_state != OLED_POWER_ON) D_WAKE();
+}
+
+uint8_t SSD1306_OLED_HW_I2C_LIB::D_POWER(void) {
+    return power_state;
+}
+
+// Hardware scrolling
+// The controller shifts the pages start_page-end_page by one column every 'speed' frames (OLED_SCROLL_*)
+// without any I2C traffic. Diagonal scrolling also moves the picture up by 'rows' pixel rows per step.
+// Scroll setup deactivates any running scroll first, as the datasheet requires.
+
+void SSD1306_OLED_HW_I2C_LIB::D_SCROLL_H(uint8_t left, uint8_t start_page, uint8_t end_page, uint8_t speed) {
+    D_START_CMD();
+    D_TX(0x2E);                                 // deactivate scroll
+    D_TX(left ? 0x27 : 0x26);                   // left / right horizontal scroll
+    D_TX(0x00);                                 // dummy byte
+    D_TX(start_page);
+    D_TX(speed);
+    D_TX(end_page);
+    D_TX(0x00);                                 // dummy bytes
+    D_TX(0xFF);
+    D_TX(0x2F);                                 // activate scroll
+    D_STOP();
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_SCROLL_DIAG(uint8_t left, uint8_t start_page, uint8_t end_page, uint8_t speed, uint8_t rows) {
+    D_START_CMD();
+    D_TX(0x2E);                                 // deactivate scroll
+    D_TX(0xA3);                                 // vertical scroll area: the whole panel
+    D_TX(0x00);
+    D_TX(disp_height);
+    D_TX(left ? 0x2A : 0x29);                   // vertical and left / right horizontal scroll
+    D_TX(0x00);                                 // dummy byte
+    D_TX(start_page);
+    D_TX(speed);
+    D_TX(end_page);
+    D_TX(rows);                                 // vertical offset per step
+    D_TX(0x2F);                                 // activate scroll
+    D_STOP();
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_SCROLL_STOP(void) {                      // stop scrolling (redraw afterwards, see datasheet)
+    D_START_CMD();
+    D_TX(0x2E);
+    D_STOP();
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_START_LINE(uint8_t line) {               // GDDRAM row shown at the top of the panel (0-63)
+    D_START_CMD();
+    D_TX(0x40 | (line & 0x3F));
+    D_STOP();
+    start_line = line & 0x3F;
+}
+
+// Text console
+// Lines are written into the 8 pages of GDDRAM in turn. Once the panel is full, the next line replaces
+// the oldest page and the display start line is moved down by one page, so appending a line costs one
+// page of data (plus 10 command bytes) instead of redrawing the screen. The console owns the whole screen
+// while it is used. In framebuffer mode it writes to fb[] like all other drawing: fb[] is shown from row 0,
+// so the lines are moved up a page in fb[] instead and D_FLUSH() sends the whole console.
+
+void SSD1306_OLED_HW_I2C_LIB::D_CONSOLE_CLEAR(void) {                    // blank all of GDDRAM and reset the console
+    con_lines = 0;
+    con_top = 0;
+#if OLED_FRAMEBUFFER
+    for (uint8_t page = 0; page < disp_pages; page++) {
+#else
+    D_START_LINE(0);
+    for (uint8_t page = 0; page < 8; page++) {
+#endif
+        D_CONSOLE_PAGE(page, "");
+    }
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_CONSOLE_LINE(const char *s) {            // append a line, scrolling the console if needed
+    uint8_t page;
+    if (con_lines < disp_pages) {                           // panel not full yet
+        page = con_lines++;
+        D_CONSOLE_PAGE(page, s);
+        return;
+    }
+#if OLED_FRAMEBUFFER
+    memmove(fb, fb + disp_width, disp_width * (disp_pages - 1));       // the lines move up a page
+    for (page = 0; page < disp_pages - 1; page++) {
+        FB_MARK(0, page);
+        FB_MARK(disp_width - 1, page);
+    }
+    D_CONSOLE_PAGE(disp_pages - 1, s);
+#else
+    page = (con_top + disp_pages) & 0x07;                   // the page just below the bottom line
+    D_CONSOLE_PAGE(page, s);
+    con_top = (con_top + 1) & 0x07;
+    D_START_LINE(con_top * 8);
+#endif
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_CONSOLE_PAGE(uint8_t page, const char *s) {      // write one text line over a whole page
+    D_WINDOW(0, disp_width - 1, page, page);
+    D_DATA_BEGIN();
+    for (uint8_t x = 0; x < disp_width; ) {
+        char ch = *s ? *s++ : ' ';                          // pad the rest of the line with blanks
+        for (uint8_t i = 0; i < 6 && x < disp_width; i++, x++) {
+            D_PUT(D_GLYPH_COL(ch, i));
+        }
+    }
+    D_DATA_END();
+    pos_lost = 1;
+}
+
+// Draw a horizontal line
+// Note: even though the line is 1px thick, it will affect 8 pixel rows
+void SSD1306_OLED_HW_I2C_LIB::D_DRAW_HOR(uint8_t xpos, uint8_t ypos, uint8_t length) {
+    if (xpos >= disp_width) return;
+    if (length > disp_width - xpos) length = disp_width - xpos;    // clipped at the right edge
+    uint8_t ypage = ypos / 8;                       // determine page (8 vertical pixels) from pixel position
+    uint8_t dot_byte = 1 << (ypos % 8);             // create a byte with a dot at the specified position within the page
+#if OLED_FRAMEBUFFER
+    for (uint8_t i = 0; i < length; i++) {          // framebuffer: only the line's own pixel row is changed
+        FB_DRAW(xpos + i, ypage, dot_byte);
+    }
+#else
+    D_SETPOS(xpos, ypage);
+    D_START_DAT();
+    for (uint8_t i = 0; i < length; i++) {
+        D_TX(dot_byte);
+    }
+	D_STOP();
+#endif
+}
+
+// Draw a vertical line
+void SSD1306_OLED_HW_I2C_LIB::D_DRAW_VERT(uint8_t xpos, uint8_t ypos, uint8_t length) {
+    D_DRAW_BOX(xpos, ypos, 1, length);                      // a 1-column window, all pages in one transaction
+}
+
+// Draw a filled rectangle
+// Note: as with the lines, the other pixels of the first and last page are cleared (except in framebuffer mode)
+void SSD1306_OLED_HW_I2C_LIB::D_DRAW_BOX(uint8_t xpos, uint8_t ypos, uint8_t width, uint8_t height) {
+    uint8_t xlast, ylast, page_first, page_last;
+    if (!D_CLIP(xpos, ypos, width, height, &xlast, &ylast)) return;
+    page_first = ypos / 8;
+    page_last = ylast / 8;
+#if OLED_FRAMEBUFFER
+    for (uint8_t page = page_first; page <= page_last; page++) {
+        uint8_t bits = D_PAGE_BITS(page, ypos, ylast);
+        for (uint8_t x = xpos; x <= xlast; x++) {
+            FB_DRAW(x, page, bits);
+        }
+    }
+#else
+    D_WINDOW(xpos, xlast, page_first, page_last);
+    D_START_DAT();
+    for (uint8_t page = page_first; page <= page_last; page++) {
+        uint8_t bits = D_PAGE_BITS(page, ypos, ylast);
+        for (uint8_t x = xpos; x <= xlast; x++) {
+            D_TX(bits);
+        }
+    }
+    D_STOP();
+#endif
+}
+
+// Draw a rectangle outline
+// Note: the inside of the pages the frame spans is cleared (except in framebuffer mode)
+void SSD1306_OLED_HW_I2C_LIB::D_DRAW_FRAME(uint8_t xpos, uint8_t ypos, uint8_t width, uint8_t height) {
+    uint8_t xlast, ylast, page_first, page_last;
+    if (!D_CLIP(xpos, ypos, width, height, &xlast, &ylast)) return;
+    page_first = ypos / 8;
+    page_last = ylast / 8;
+#if !OLED_FRAMEBUFFER
+    D_WINDOW(xpos, xlast, page_first, page_last);
+    D_START_DAT();
+#endif
+    for (uint8_t page = page_first; page <= page_last; page++) {
+        uint8_t side = D_PAGE_BITS(page, ypos, ylast);          // left and right edges
+        uint8_t edge = 0;                                       // top and bottom edges
+        if (page == page_first) edge |= 1 << (ypos % 8);
+        if (page == page_last) edge |= 1 << (ylast % 8);
+        for (uint8_t x = xpos; x <= xlast; x++) {
+            uint8_t bits = (x == xpos || x == xlast) ? side : edge;
+#if OLED_FRAMEBUFFER
+            FB_DRAW(x, page, bits);
+#else
+            D_TX(bits);
+#endif
+        }
+    }
+#if !OLED_FRAMEBUFFER
+    D_STOP();
+#endif
+}
+
+// Pixel graphics (framebuffer mode)
+// Pixels, lines and circles change only their own pixels in fb[], combined as set with D_SET_DRAW_MODE
+// (which also applies to D_DRAW_HOR / _VERT / _BOX / _FRAME), and only the columns that change are sent
+// by the next D_FLUSH(). Shapes may run off the screen; what is outside is clipped. Every pixel is drawn
+// once, so OLED_DRAW_INVERT draws and erases a shape without remembering what was under it.
+// Lines use Bresenham's algorithm, steep parts being drawn as column runs (one byte per page); circles
+// use the midpoint algorithm, filled circles one column run per column.
+// Without a framebuffer GDDRAM cannot be read back over I2C, and these functions do nothing.
+
+#if OLED_FRAMEBUFFER
+
+void SSD1306_OLED_HW_I2C_LIB::D_SET_DRAW_MODE(uint8_t mode) {
+    draw_mode = mode;
+}
+
+void SSD1306_OLED_HW_I2C_LIB::FB_PIXEL(int16_t x, int16_t y) {
+    if (x < 0 || x >= disp_width || y < 0 || y >= disp_height) return;
+    FB_DRAW(x, y >> 3, 1 << (y & 7));
+}
+
+void SSD1306_OLED_HW_I2C_LIB::FB_COLUMN(int16_t x, int16_t ytop, int16_t ybottom) {   // pixel rows ytop-ybottom of a column
+    if (x < 0 || x >= disp_width) return;
+    if (ytop < 0) ytop = 0;
+    if (ybottom > disp_height - 1) ybottom = disp_height - 1;
+    if (ytop > ybottom) return;
+    for (uint8_t page = ytop >> 3; page <= (ybottom >> 3); page++) {
+        FB_DRAW(x, page, D_PAGE_BITS(page, ytop, ybottom));
+    }
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_PIXEL(uint8_t x, uint8_t y) {
+    FB_PIXEL(x, y);
+}
+
+uint8_t SSD1306_OLED_HW_I2C_LIB::D_GET_PIXEL(uint8_t x, uint8_t y) {    // 1 if the pixel is lit in fb[]
+    if (x >= disp_width || y >= disp_height) return 0;
+    return (fb[(y >> 3) * disp_width + x] >> (y & 7)) & 1;
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_LINE(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1) {
+    if (x0 > x1) {                                      // always draw left to right
+        uint8_t t = x0; x0 = x1; x1 = t;
+        t = y0; y0 = y1; y1 = t;
+    }
+    int16_t dx = x1 - x0;
+    int16_t dy = (y1 > y0) ? y1 - y0 : y0 - y1;
+    int8_t step = (y1 > y0) ? 1 : -1;
+    if (dy > dx) {                                      // steep: one run of rows per column
+        int16_t err = dy / 2;
+        int16_t y = y0;
+        for (int16_t x = x0; x <= x1; x++) {
+            int16_t run = y;                            // first row of this column
+            if (x == x1) {
+                y = y1;                                 // the last column takes the rest
+            } else {
+                while ((err -= dx) >= 0) y += step;     // rows until the line moves to the next column
+                err += dy;
+            }
+            FB_COLUMN(x, (step > 0) ? run : y, (step > 0) ? y : run);
+            y += step;
+        }
+    } else {                                            // flat: one pixel per column
+        int16_t err = dx / 2;
+        int16_t y = y0;
+        for (int16_t x = x0; x <= x1; x++) {
+            FB_PIXEL(x, y);
+            err -= dy;
+            if (err < 0) {
+                y += step;
+                err += dx;
+            }
+        }
+    }
+}
+
+void SSD1306_OLED_HW_I2C_LIB::FB_CIRCLE_POINTS(int16_t x, int16_t y, int16_t dx, int16_t dy) {   // the 4 mirror images, each once
+    FB_PIXEL(x + dx, y + dy);
+    if (dx) FB_PIXEL(x - dx, y + dy);
+    if (dy) FB_PIXEL(x + dx, y - dy);
+    if (dx && dy) FB_PIXEL(x - dx, y - dy);
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_CIRCLE(uint8_t x, uint8_t y, uint8_t r) {
+    int16_t dx = r, dy = 0;
+    int16_t err = 1 - r;
+    while (dy <= dx) {                                  // one octant, mirrored
+        FB_CIRCLE_POINTS(x, y, dx, dy);
+        if (dx != dy) FB_CIRCLE_POINTS(x, y, dy, dx);
+        dy++;
+        if (err < 0) {
+            err += 2 * dy + 1;
+        } else {
+            dx--;
+            err += 2 * (dy - dx) + 1;
+        }
+    }
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_FILL_CIRCLE(uint8_t x, uint8_t y, uint8_t r) {
+    int16_t h = r;                                      // half height of the column dx away from the centre
+    int16_t limit = (int16_t)r * r + r;                 // same outline as D_CIRCLE
+    for (int16_t dx = 0; dx <= r; dx++) {
+        while (h > 0 && dx * dx + h * h > limit) h--;
+        FB_COLUMN(x + dx, y - h, y + h);
+        if (dx) FB_COLUMN(x - dx, y - h, y + h);
+    }
+}
+
+#else
+
+void SSD1306_OLED_HW_I2C_LIB::D_SET_DRAW_MODE(uint8_t) {
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_PIXEL(uint8_t, uint8_t) {
+}
+
+uint8_t SSD1306_OLED_HW_I2C_LIB::D_GET_PIXEL(uint8_t, uint8_t) {
+    return 0;
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_LINE(uint8_t, uint8_t, uint8_t, uint8_t) {
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_CIRCLE(uint8_t, uint8_t, uint8_t) {
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_FILL_CIRCLE(uint8_t, uint8_t, uint8_t) {
+}
+
+#endif
+
+// Draw a bitmap
+// Images are page-major, the layout most SSD1306 image converters produce: 'width' bytes for the first
+// page (bit 0 = top pixel of the page), then 'width' bytes for the next page, and so on. The window is set
+// once and the whole image is streamed in one data transaction; parts outside the screen are skipped.
+// RLE format: a control byte n < 0x80 is followed by n+1 literal bytes, n >= 0x80 by one byte
+// that is repeated n - 0x7E times (2-129). Runs may continue across page boundaries.
+#define BITMAP_RAM                      0
+#define BITMAP_PROGMEM                  1
+#define BITMAP_RLE                      2
+
+void SSD1306_OLED_HW_I2C_LIB::D_DRAW_BITMAP(uint8_t xpos, uint8_t page, uint8_t width, uint8_t pages, const uint8_t *bitmap) {
+    D_BLIT(xpos, page, width, pages, bitmap, BITMAP_PROGMEM);
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_DRAW_BITMAP_RAM(uint8_t xpos, uint8_t page, uint8_t width, uint8_t pages, const uint8_t *bitmap) {
+    D_BLIT(xpos, page, width, pages, bitmap, BITMAP_RAM);
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_DRAW_BITMAP_RLE(uint8_t xpos, uint8_t page, uint8_t width, uint8_t pages, const uint8_t *bitmap) {
+    D_BLIT(xpos, page, width, pages, bitmap, BITMAP_RLE);
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_BLIT(uint8_t xpos, uint8_t page, uint8_t width, uint8_t pages, const uint8_t *bitmap, uint8_t source) {
+    if (width == 0 || pages == 0 || xpos >= disp_width || page >= disp_pages) return;
+    uint8_t xlast = (xpos + width > disp_width) ? disp_width - 1 : xpos + width - 1;
+    uint8_t page_last = (page + pages > disp_pages) ? disp_pages - 1 : page + pages - 1;
+    uint8_t run = 0, literal = 0, value = 0;                // RLE decoder state
+
+    D_WINDOW(xpos, xlast, page, page_last);
+    D_DATA_BEGIN();
+    for (uint8_t p = page; p <= page_last; p++) {
+        for (uint8_t col = 0; col < width; col++) {
+            uint8_t data;
+            if (source == BITMAP_RAM) {
+                data = *bitmap++;
+            } else if (source == BITMAP_PROGMEM) {
+                data = pgm_read_byte(bitmap++);
+            } else {
+                if (run == 0) {                             // next control byte
+                    uint8_t n = pgm_read_byte(bitmap++);
+                    literal = (n < 0x80);
+                    run = literal ? n + 1 : n - 0x7E;
+                    if (!literal) value = pgm_read_byte(bitmap++);
+                }
+                data = literal ? pgm_read_byte(bitmap++) : value;
+                run--;
+            }
+            if (col <= xlast - xpos) D_PUT(data);           // columns past the right edge are skipped
+        }
+    }
+    D_DATA_END();
+}
+
+// Clip a rectangle to the screen, returns 0 if nothing is left to draw
+uint8_t SSD1306_OLED_HW_I2C_LIB::D_CLIP(uint8_t xpos, uint8_t ypos, uint8_t width, uint8_t height, uint8_t *xlast, uint8_t *ylast) {
+    if (width == 0 || height == 0 || xpos >= disp_width || ypos >= disp_height) return 0;
+    uint16_t xend = xpos + width - 1;
+    uint16_t yend = ypos + height - 1;
+    *xlast = (xend > disp_width - 1) ? disp_width - 1 : xend;
+    *ylast = (yend > disp_height - 1) ? disp_height - 1 : yend;
+    return 1;
+}
+
+// Pixels of a page covered by the pixel rows ytop-ybottom (bit 0 is the top row of the page)
+uint8_t SSD1306_OLED_HW_I2C_LIB::D_PAGE_BITS(uint8_t page, uint8_t ytop, uint8_t ybottom) {
+    uint8_t bits = 0xFF;
+    if (page == ytop / 8) bits &= 0xFF << (ytop % 8);
+    if (page == ybottom / 8) bits &= 0xFF >> (7 - ybottom % 8);
+    return bits;
+}
+
+
+// Pixel data output: straight to the display in direct mode, into fb[] in framebuffer mode.
+// D_DATA_BEGIN/D_DATA_END bracket one data transaction, D_PUT writes one column byte at the pointer.
+
+void SSD1306_OLED_HW_I2C_LIB::D_DATA_BEGIN(void) {
+#if !OLED_FRAMEBUFFER
+    D_START_DAT();
+#endif
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_PUT(uint8_t data) {
+#if OLED_FRAMEBUFFER
+    FB_PUT(data);
+#else
+    D_TX(data);
+#endif
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_PUT_BLOCK(const uint8_t *src, uint8_t count) {  // D_PUT of 'count' bytes from SRAM
+#if OLED_FRAMEBUFFER
+    for (; count; count--) FB_PUT(*src++);
+#else
+    D_SEND_BLOCK(src, count);                               // inside a data transaction D_TX would only pass them on
+#endif
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_DATA_END(void) {
+#if !OLED_FRAMEBUFFER
+    D_STOP();
+#endif
+}
+
+uint8_t SSD1306_OLED_HW_I2C_LIB::D_GLYPH_COL(char ch, uint8_t col) {                 // column 0-5 of a character (built-in font)
+#if OLED_GLYPH_CACHE
+    uint8_t slot = (uint8_t)ch - OLED_GLYPH_CACHE_FIRST;
+    if (glyph_builtin && slot <= OLED_GLYPH_CACHE_LAST - OLED_GLYPH_CACHE_FIRST) return glyph_cache[slot][col];
+#endif
+	uint8_t c = ch - ' ';
+    if (col == 0 || c > '~' - ' ') return 0x00;             // character leading 1 px space, blank outside the font
+    return pgm_read_byte(&D_FONT6x8[c * 5 + col - 1]);
+}
+
+// Fonts
+// A glyph is stored page by page: 'width' columns of its top page, then 'width' columns of the next one.
+// Fixed-width fonts index the bitmap directly; proportional fonts have a table with the first column of
+// every glyph (last - first + 2 entries, the final one marking the end), so a lookup is O(1) either way.
+// Characters outside first-last print as blanks of 'width' columns.
+
+void SSD1306_OLED_HW_I2C_LIB::D_SET_FONT(const OLED_FONT *f) {                       // select a font (descriptor in PROGMEM)
+    memcpy_P(&font, f, sizeof(font));
+#if OLED_GLYPH_CACHE
+    uint8_t all = 1;
+    for (uint8_t slot = 0; slot <= OLED_GLYPH_CACHE_LAST - OLED_GLYPH_CACHE_FIRST; slot++) {
+        uint8_t width;
+        const uint8_t *glyph = D_FONT_GLYPH(OLED_GLYPH_CACHE_FIRST + slot, &width);
+        uint8_t cols = font.spacing + width;
+        if (font.pages != 1 || cols > OLED_GLYPH_CACHE_COLS) {
+            glyph_cols[slot] = 0;                                   // served from PROGMEM
+            all = 0;
+            continue;
+        }
+        uint8_t *cache = glyph_cache[slot];
+        for (uint8_t col = 0; col < cols; col++) {
+            cache[col] = (col >= font.spacing && glyph) ? pgm_read_byte(glyph + col - font.spacing) : 0x00;
+        }
+        glyph_cols[slot] = cols;
+    }
+    glyph_builtin = all && font.bitmap == D_FONT6x8 && OLED_GLYPH_CACHE_COLS >= 6;
+#endif
+}
+
+const uint8_t *SSD1306_OLED_HW_I2C_LIB::D_FONT_GLYPH(char ch, uint8_t *width) {      // PROGMEM columns of a character, 0 if not in the font
+    uint8_t c = ch;
+    *width = font.width;
+    if (c < font.first || c > font.last) return 0;
+    c -= font.first;
+    if (!font.offsets) return font.bitmap + (uint16_t)c * font.width * font.pages;
+    uint16_t start = pgm_read_word(&font.offsets[c]);
+    *width = pgm_read_word(&font.offsets[c + 1]) - start;
+    return font.bitmap + start * font.pages;
+}
+
+// Text output in the current font, one data transaction per string.
+// Single-page fonts stream at the RAM pointer, so text wraps to the next page like the controller does.
+// Taller or scaled text is written through a window from the text position (D_SETPOS) that covers the
+// whole string, row of pages by row of pages, and is clipped at the right edge of the screen.
+// Scaling stretches every glyph column on the fly: each source bit becomes 'scale' pixel rows and each
+// column is repeated 'scale' times, so 2x and 4x text needs neither a large font nor a framebuffer.
+// flash = 1: the string is in PROGMEM.
+#define D_STR_CHAR(p, flash)            ((flash) ? (char)pgm_read_byte(p) : *(p))
+
+void SSD1306_OLED_HW_I2C_LIB::D_TEXT(const char *s, uint8_t scale, uint8_t flash) {
+    uint8_t width;
+    const uint8_t *glyph;
+    char ch;
+    if (font.pages == 1 && scale == 1) {
+        if (print_open) {                                   // D_PRINT_BEGIN holds the transaction open
+            for (; (ch = D_STR_CHAR(s, flash)); s++) D_STREAM_CHAR(ch);    // new lines included
+            return;
+        }
+        if (pos_lost) D_SETPOS(cur_x, cur_page);            // the pointer was left in a text window
+        D_DATA_BEGIN();
+        for (; (ch = D_STR_CHAR(s, flash)); s++) D_GLYPH_OUT(ch);
+        D_DATA_END();
+        return;
+    }
+    if (print_open) {                                       // font or scale changed after D_PRINT_BEGIN
+        D_DATA_END();
+        print_open = 0;
+    }
+
+    uint16_t total = D_STR_WIDTH(s, flash) * scale;
+    if (total > disp_width - cur_x) total = disp_width - cur_x;
+    if (total == 0) return;
+    uint8_t pages = font.pages * scale;
+    uint8_t page_last = cur_page + pages - 1;
+    if (page_last > disp_pages - 1) page_last = disp_pages - 1;
+    uint8_t shift = 8 / scale;                              // source bits per output page
+    D_WINDOW(cur_x, cur_x + total - 1, cur_page, page_last);
+    D_DATA_BEGIN();
+    for (uint8_t row = 0; row <= page_last - cur_page; row++) {
+        uint8_t src_page = row / scale;
+        uint8_t src_shift = (row % scale) * shift;
+        uint8_t left = total;
+        for (const char *p = s; (ch = D_STR_CHAR(p, flash)) && left; p++) {
+            glyph = D_FONT_GLYPH(ch, &width);
+            for (uint8_t col = 0; col < font.spacing + width && left; col++) {
+                uint8_t bits = 0x00;
+                if (col >= font.spacing && glyph) {
+                    bits = pgm_read_byte(glyph + src_page * width + col - font.spacing);
+                    if (scale > 1) bits = D_SCALE_BITS(bits >> src_shift, scale);
+                }
+                for (uint8_t i = 0; i < scale && left; i++, left--) D_PUT(bits);
+            }
+        }
+    }
+    D_DATA_END();
+    cur_x += total;
+    if (cur_x >= disp_width) {                              // line full: continue below it
+        cur_x = 0;
+        cur_page = (cur_page + pages) % disp_pages;
+    }
+    pos_lost = 1;
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_GLYPH_OUT(char ch) {                                 // one single-page glyph at the pointer (data transaction open)
+    uint16_t x;
+#if OLED_GLYPH_CACHE
+    uint8_t slot = (uint8_t)ch - OLED_GLYPH_CACHE_FIRST;
+    if (slot <= OLED_GLYPH_CACHE_LAST - OLED_GLYPH_CACHE_FIRST && glyph_cols[slot]) {
+        D_PUT_BLOCK(glyph_cache[slot], glyph_cols[slot]);   // cached: spacing and columns in one go
+        x = cur_x + glyph_cols[slot];
+    } else
+#endif
+    {
+        uint8_t width;
+        const uint8_t *glyph = D_FONT_GLYPH(ch, &width);
+        for (uint8_t col = 0; col < font.spacing; col++) D_PUT(0x00);
+        for (uint8_t col = 0; col < width; col++) D_PUT(glyph ? pgm_read_byte(glyph + col) : 0x00);
+        x = cur_x + font.spacing + width;                   // follow the pointer
+    }
+    while (x >= disp_width) {
+        x -= disp_width;
+        cur_page = (cur_page + 1) % disp_pages;
+    }
+    cur_x = x;
+}
+
+uint8_t SSD1306_OLED_HW_I2C_LIB::D_SCALE_BITS(uint8_t bits, uint8_t scale) {         // stretch the low 8/scale bits to 8 pixel rows
+    uint8_t out = 0;
+    uint8_t mask = 0xFF >> (8 - scale);                     // 'scale' pixel rows
+    for (uint8_t b = 0; b < 8; b += scale, bits >>= 1) {
+        if (bits & 1) out |= mask << b;
+    }
+    return out;
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_SET_SCALE(uint8_t scale) {                            // scale of D_PRINT_* text: 1, 2, 4 or 8
+    text_scale = (scale == 2 || scale == 4 || scale == 8) ? scale : 1;
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_PRINT_STR_SCALED(const char *s, uint8_t scale) {      // print a string 'scale' times as large
+    D_TEXT(s, (scale == 2 || scale == 4 || scale == 8) ? scale : 1);
+}
+
+uint8_t SSD1306_OLED_HW_I2C_LIB::D_TEXT_WIDTH(const char *s) {                       // width of a string in pixels (current font)
+    return D_STR_WIDTH(s, 0);
+}
+
+uint8_t SSD1306_OLED_HW_I2C_LIB::D_STR_WIDTH(const char *s, uint8_t flash) {
+    uint16_t total = 0;
+    uint8_t width;
+    char ch;
+    for (; (ch = D_STR_CHAR(s, flash)); s++) {
+        D_FONT_GLYPH(ch, &width);
+        total += font.spacing + width;
+    }
+    return (total > 255) ? 255 : total;
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_PRINT_CHAR(char ch) {                                // print 1 character
+    char s[2] = { ch, 0 };
+    D_TEXT(s, text_scale);
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_PRINT_STR(const char *s) {                           // print string (char array)
+    D_TEXT(s, text_scale);
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_PRINT_STR_P(const char *s) {                         // print string from PROGMEM
+    D_TEXT(s, text_scale, 1);
+}
+
+// Streamed text
+// Between D_PRINT_BEGIN and D_PRINT_END the data transaction of single-page, unscaled text stays open, so
+// D_PRINT_*, D_PRINTF and print() add their glyphs to it as the characters are produced and no string
+// has to be assembled in RAM first. Only text may be output in between. A new line ends the transaction,
+// sets the position and opens the next one. Taller or scaled text falls back to one window per call.
+
+void SSD1306_OLED_HW_I2C_LIB::D_PRINT_BEGIN(void) {
+    if (print_nest++ || font.pages != 1 || text_scale != 1) return;
+    if (pos_lost) D_SETPOS(cur_x, cur_page);
+    D_DATA_BEGIN();
+    print_open = 1;
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_PRINT_END(void) {
+    if (!print_nest || --print_nest) return;
+    if (print_open) D_DATA_END();
+    print_open = 0;
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_STREAM_CHAR(char ch) {                               // one character of streamed text
+    if (ch == '\r') return;
+    if (ch == '\n') {                                       // start of the next text line
+        if (print_open) D_DATA_END();
+        D_SETPOS(0, (cur_page + font.pages * text_scale) % disp_pages);
+        if (print_open) D_DATA_BEGIN();
+    } else if (print_open) {
+        D_GLYPH_OUT(ch);
+    } else {
+        char s[2] = { ch, 0 };
+        D_TEXT(s, text_scale);
+    }
+}
+
+size_t SSD1306_OLED_HW_I2C_LIB::write(uint8_t ch) {                                  // Print interface
+    D_STREAM_CHAR(ch);
+    return 1;
+}
+
+size_t SSD1306_OLED_HW_I2C_LIB::write(const uint8_t *buffer, size_t size) {          // print(), println(): one transaction per call
+    D_PRINT_BEGIN();
+    for (size_t i = 0; i < size; i++) D_STREAM_CHAR(buffer[i]);
+    D_PRINT_END();
+    return size;
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_PRINTF(const char *format, ...) {                     // formatted output, no buffer
+    va_list args;
+    va_start(args, format);
+    D_VPRINTF(format, 0, args);
+    va_end(args);
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_PRINTF_P(const char *format, ...) {                   // formatted output, format in PROGMEM
+    va_list args;
+    va_start(args, format);
+    D_VPRINTF(format, 1, args);
+    va_end(args);
+}
+
+// A subset of printf: %d %i %u %x %X %c %s %S %%, the flags '-' (left-align) and '0' (zero padding), a
+// field width and the 'l' prefix for long arguments. %S is a string in PROGMEM, as in avr-libc.
+// Numbers are converted with D_UTOA into a 10-byte buffer; everything else goes straight to the display.
+void SSD1306_OLED_HW_I2C_LIB::D_VPRINTF(const char *format, uint8_t flash, va_list args) {
+    char ch;
+    D_PRINT_BEGIN();
+    while ((ch = D_STR_CHAR(format, flash))) {
+        format++;
+        if (ch != '%') {
+            D_STREAM_CHAR(ch);
+            continue;
+        }
+        uint8_t left = 0, width = 0, is_long = 0, negative = 0, text_flash = 0;
+        char pad = ' ';
+        for (; (ch = D_STR_CHAR(format, flash)) == '-' || ch == '0'; format++) {
+            if (ch == '-') left = 1;
+            else pad = '0';
+        }
+        for (; ch >= '0' && ch <= '9'; ch = D_STR_CHAR(++format, flash)) width = width * 10 + ch - '0';
+        if (ch == 'l') {
+            is_long = 1;
+            ch = D_STR_CHAR(++format, flash);
+        }
+        if (!ch) break;                                     // format ends inside a conversion
+        format++;
+
+        char buffer[10];
+        char *end = buffer + sizeof(buffer);
+        const char *text = end - 1;
+        uint8_t len = 1;
+        if (ch == 'd' || ch == 'i') {
+            int32_t value = is_long ? (int32_t)va_arg(args, long) : va_arg(args, int);
+            uint32_t magnitude = (value < 0) ? -(uint32_t)value : value;
+            text = D_UTOA(magnitude, end, 1);
+            negative = value < 0;
+            len = end - text;
+        } else if (ch == 'u' || ch == 'x' || ch == 'X') {
+            uint32_t value = is_long ? (uint32_t)va_arg(args, unsigned long) : va_arg(args, unsigned int);
+            if (ch == 'u') {
+                text = D_UTOA(value, end, 1);
+            } else {
+                char *p = end;
+                char a = (ch == 'x') ? 'a' : 'A';
+                do {
+                    uint8_t nibble = value & 0x0F;
+                    *--p = (nibble < 10) ? '0' + nibble : a - 10 + nibble;
+                    value >>= 4;
+                } while (value);
+                text = p;
+            }
+            len = end - text;
+        } else if (ch == 's' || ch == 'S') {
+            text = va_arg(args, const char *);
+            text_flash = (ch == 'S');
+            if (!text) text = "";
+            for (len = 0; len < 255 && D_STR_CHAR(text + len, text_flash); len++) {}
+        } else if (ch == 'c') {
+            end[-1] = (char)va_arg(args, int);
+        } else {
+            end[-1] = ch;                                   // %% and unknown conversions print the character
+        }
+
+        if (left || text_flash || ch == 's' || ch == 'c') pad = ' ';   // zero padding is for numbers only
+        uint8_t total = len + negative;
+        if (negative && pad == '0') D_STREAM_CHAR('-');
+        if (!left) for (; total < width; total++) D_STREAM_CHAR(pad);
+        if (negative && pad != '0') D_STREAM_CHAR('-');
+        for (uint8_t i = 0; i < len; i++) D_STREAM_CHAR(D_STR_CHAR(text + i, text_flash));
+        for (; total < width; total++) D_STREAM_CHAR(' ');
+    }
+    D_PRINT_END();
+}
+
+// Number output
+// Digits are produced right to left into a small buffer on the stack. 16-bit values use a multiply
+// and shift instead of a division by 10 (exact for n < 81920), larger values are first split into
+// 4-digit groups with one 32-bit division each, so a 10-digit number costs two divisions.
+// width = minimum number of characters, pad = ' ' (sign after padding) or '0' (sign before zeros).
+
+char *SSD1306_OLED_HW_I2C_LIB::D_UTOA(uint32_t num, char *end, uint8_t min_digits) {  // digits of num, written backwards from end
+    char *p = end;
+    while (num > 0xFFFF) {
+        uint32_t q = num / 10000;
+        uint16_t r = num - q * 10000;
+        for (uint8_t i = 0; i < 4; i++) {                   // exactly 4 digits per group
+            uint16_t q10 = ((uint32_t)r * 0xCCCD) >> 19;    // r / 10
+            *--p = '0' + (r - q10 * 10);
+            r = q10;
+        }
+        num = q;
+    }
+    uint16_t n = num;
+    do {
+        uint16_t q10 = ((uint32_t)n * 0xCCCD) >> 19;        // n / 10
+        *--p = '0' + (n - q10 * 10);
+        n = q10;
+    } while (n);
+    while (end - p < min_digits) *--p = '0';
+    return p;
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_PRINT_NUM(const char *digits, const char *end, uint8_t negative, uint8_t width, char pad) {
+    char text[24];
+    char *p = text;
+    uint8_t len = (end - digits) + negative;
+    if (width > sizeof(text) - 1) width = sizeof(text) - 1;
+    if (negative && pad == '0') *p++ = '-';
+    for (; len < width; len++) *p++ = pad;
+    if (negative && pad != '0') *p++ = '-';
+    while (digits < end) *p++ = *digits++;
+    *p = 0;
+    D_TEXT(text, text_scale);
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_PRINT_INT(uint16_t num) {                            // print integer variable
+    D_PRINT_UINT(num);
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_PRINT_UINT(uint32_t num, uint8_t width, char pad) {  // print unsigned 16/32-bit integer
+    char buffer[10];
+    char *end = buffer + sizeof(buffer);
+    D_PRINT_NUM(D_UTOA(num, end, 1), end, 0, width, pad);
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_PRINT_SINT(int32_t num, uint8_t width, char pad) {   // print signed 16/32-bit integer
+    char buffer[10];
+    char *end = buffer + sizeof(buffer);
+    uint32_t magnitude = (num < 0) ? -(uint32_t)num : num;
+    D_PRINT_NUM(D_UTOA(magnitude, end, 1), end, num < 0, width, pad);
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_PRINT_HEX(uint32_t num, uint8_t digits) {           // print hexadecimal, zero padded to 'digits'
+    char buffer[8];
+    char *end = buffer + sizeof(buffer);
+    char *p = end;
+    do {
+        uint8_t nibble = num & 0x0F;
+        *--p = (nibble < 10) ? '0' + nibble : 'A' - 10 + nibble;
+        num >>= 4;
+    } while (num);
+    while (end - p < digits && p > buffer) *--p = '0';
+    D_PRINT_NUM(p, end, 0, 0, ' ');
+}
+
+// Print value / 10^decimals with a decimal point, e.g. D_PRINT_FIXED(-1234, 2) prints -12.34
+void SSD1306_OLED_HW_I2C_LIB::D_PRINT_FIXED(int32_t value, uint8_t decimals, uint8_t width, char pad) {
+    char buffer[12];
+    char *end = buffer + sizeof(buffer);
+    uint32_t magnitude = (value < 0) ? -(uint32_t)value : value;
+    if (decimals > 9) decimals = 9;
+    char *p = D_UTOA(magnitude, end, decimals + 1);         // at least one digit before the point
+    if (decimals) {
+        char *point = end - decimals;                       // first fractional digit
+        for (char *q = p; q < point; q++) q[-1] = q[0];     // move the integer part left to make room
+        point[-1] = '.';
+        p--;
+    }
+    D_PRINT_NUM(p, end, value < 0, width, pad);
+}
+
+// Numeric fields
+// The new text is compared with field->text column by column; only the span from the first to the
+// last changed column is sent, as one position command (a window for taller fonts) and one data
+// transaction. Characters are drawn in the current font, each in a cell as wide as its widest digit, sign
+// or '#', clipped at the right edge of the screen; the text position is left after the field like D_TEXT.
+// field->text says nothing about the font: after D_SET_FONT, D_FIELD_INIT again to redraw the field.
+
+void SSD1306_OLED_HW_I2C_LIB::D_FIELD_INIT(OLED_FIELD *field, uint8_t x, uint8_t y, uint8_t width) {
+    field->x = x;
+    field->page = y;
+    field->width = (width > OLED_FIELD_MAX) ? OLED_FIELD_MAX : width;
+    for (uint8_t i = 0; i < OLED_FIELD_MAX; i++) {
+        field->text[i] = 0;                                 // unknown: the first update draws the whole field
+    }
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_FIELD_UINT(OLED_FIELD *field, uint32_t num) {
+    char buffer[10];
+    char *end = buffer + sizeof(buffer);
+    D_FIELD_SHOW(field, D_UTOA(num, end, 1), end, 0);
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_FIELD_SINT(OLED_FIELD *field, int32_t num) {
+    char buffer[10];
+    char *end = buffer + sizeof(buffer);
+    uint32_t magnitude = (num < 0) ? -(uint32_t)num : num;
+    D_FIELD_SHOW(field, D_UTOA(magnitude, end, 1), end, num < 0);
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_FIELD_SHOW(OLED_FIELD *field, const char *digits, const char *end, uint8_t negative) {
+    char text[OLED_FIELD_MAX];
+    uint8_t width = field->width;
+    uint8_t len = (end - digits) + negative;
+    for (uint8_t i = 0; i < width; i++) {                   // right-aligned, space padded
+        if (len > width) text[i] = '#';
+        else if (i < width - len) text[i] = ' ';
+        else if (negative && i == width - len) text[i] = '-';
+        else text[i] = *digits++;
+    }
+
+    uint8_t cell = D_FIELD_CELL();
+    uint8_t pages = (field->page < disp_pages) ? disp_pages - field->page : 0;
+    if (pages > font.pages) pages = font.pages;
+    uint16_t first = 0xFFFF, last = 0, c = 0;
+    for (uint8_t i = 0; i < width; i++, c += cell) {
+        char shown = field->text[i];
+        field->text[i] = text[i];
+        if (shown == text[i]) continue;
+        uint8_t new_width, old_width;
+        const uint8_t *new_glyph = D_FONT_GLYPH(text[i], &new_width);
+        const uint8_t *old_glyph = D_FONT_GLYPH(shown, &old_width);
+        for (uint8_t col = 0; col < cell; col++) {
+            for (uint8_t page = 0; page < pages; page++) {
+                if (shown == 0 || D_CELL_BITS(new_glyph, new_width, col, page) != D_CELL_BITS(old_glyph, old_width, col, page)) {
+                    if (first == 0xFFFF) first = c + col;
+                    last = c + col;
+                    break;
+                }
+            }
+        }
+    }
+
+    uint16_t visible = (field->x < disp_width) ? disp_width - field->x : 0;    // clipped at the right edge
+    if (first < visible && pages) {
+        if (last >= visible) last = visible - 1;
+        if (pages == 1) D_SETPOS(field->x + first, field->page);
+        else D_WINDOW(field->x + first, field->x + last, field->page, field->page + pages - 1);
+        D_DATA_BEGIN();
+        for (uint8_t page = 0; page < pages; page++) {
+            uint8_t i = first / cell, col = first % cell, glyph_width;
+            const uint8_t *glyph = D_FONT_GLYPH(text[i], &glyph_width);
+            for (c = first; c <= last; c++, col++) {
+                if (col == cell) {                          // next character
+                    col = 0;
+                    glyph = D_FONT_GLYPH(text[++i], &glyph_width);
+                }
+                D_PUT(D_CELL_BITS(glyph, glyph_width, col, page));
+            }
+        }
+        D_DATA_END();
+    }
+
+    uint16_t x = field->x + (uint16_t)width * cell;         // text position after the field, as D_TEXT leaves it
+    cur_page = field->page;
+    if (x >= disp_width) {
+        x = 0;
+        cur_page = (field->page + font.pages) % disp_pages;
+    }
+    cur_x = x;
+    pos_lost = 1;
+}
+
+uint8_t SSD1306_OLED_HW_I2C_LIB::D_FIELD_CELL(void) {                              // columns per field character: the widest one it can show
+    static const char chars[] PROGMEM = "0123456789 -#";
+    uint8_t cell = 0;
+    for (const char *p = chars; pgm_read_byte(p); p++) {
+        uint8_t width;
+        D_FONT_GLYPH(pgm_read_byte(p), &width);
+        if (width > cell) cell = width;
+    }
+    return font.spacing + cell;
+}
+
+uint8_t SSD1306_OLED_HW_I2C_LIB::D_CELL_BITS(const uint8_t *glyph, uint8_t width, uint8_t col, uint8_t page) {   // column of a glyph in a cell
+    if (col < font.spacing || !glyph) return 0x00;          // spacing in front, blank outside the font
+    col -= font.spacing;
+    if (col >= width) return 0x00;                          // narrower glyph: blank up to the cell's width
+    return pgm_read_byte(glyph + page * width + col);
+}
+
+// Plots
+// A plot keeps the pixel row of its last 'width' samples. In sweep mode a new sample is drawn at a cursor
+// that moves right and wraps, with a blank column ahead of it, like an oscilloscope: one window of two
+// columns, 2 data bytes per page. In scroll mode the graph moves left: the SSD1306 content scroll command
+// (0x2D, one column per command) shifts the plot area in GDDRAM and only the new rightmost column is sent,
+// 1 data byte per page plus two commands. Not every clone has 0x2C/0x2D, and the datasheet asks for two
+// frames (~30 ms) between them; OLED_PLOT_REDRAW sends the whole area instead. In framebuffer mode the
+// shift is done in fb[] and D_FLUSH() sends only the columns that really changed.
+// Line plots join each sample to the previous one with a vertical run, so steep edges stay connected.
+
+void SSD1306_OLED_HW_I2C_LIB::D_PLOT_INIT(OLED_PLOT *plot, uint8_t x, uint8_t page, uint8_t width, uint8_t pages, int16_t min, int16_t max, uint8_t mode) {
+    if (width > OLED_PLOT_MAX) width = OLED_PLOT_MAX;
+    if (x >= disp_width || page >= disp_pages) width = pages = 0;  // off the screen: pushes do nothing
+    if (x + width > disp_width) width = disp_width - x;
+    if (page + pages > disp_pages) pages = disp_pages - page;
+    if (max <= min) {                                           // empty range: one step above min
+        if (min == 0x7FFF) min--;
+        max = min + 1;
+    }
+    plot->x = x;
+    plot->page = page;
+    plot->width = width;
+    plot->pages = pages;
+    plot->mode = mode;
+    plot->min = min;
+    plot->max = max;
+    plot->count = 0;
+    plot->next = 0;
+    if (width && pages) D_FILL_RECT(x, page, width, pages, 0x00);   // scrolling relies on a known (blank) area
+}
+
+uint8_t SSD1306_OLED_HW_I2C_LIB::D_PLOT_ROW(OLED_PLOT *plot, uint8_t col) {   // row shown in a column, 0xFF if blank
+    uint8_t width = plot->width;
+    if ((plot->mode & ~OLED_PLOT_BARS) == OLED_PLOT_SWEEP) {
+        if (col >= plot->count || col == plot->next) return 0xFF;   // not reached yet / the gap ahead of the cursor
+        return plot->rows[col];
+    }
+    uint8_t age = width - 1 - col;                              // rightmost column = newest sample
+    if (age >= plot->count) return 0xFF;
+    uint8_t slot = plot->next + width - 1 - age;
+    return plot->rows[(slot >= width) ? slot - width : slot];
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_PLOT_COLUMNS(OLED_PLOT *plot, uint8_t first, uint8_t last) {   // send columns first-last
+    D_WINDOW(plot->x + first, plot->x + last, plot->page, plot->page + plot->pages - 1);
+    D_DATA_BEGIN();
+    for (uint8_t page = 0; page < plot->pages; page++) {
+        for (uint8_t col = first; col <= last; col++) {
+            uint8_t row = D_PLOT_ROW(plot, col);
+            uint8_t bits = 0x00;
+            if (row != 0xFF) {
+                uint8_t top = row, bottom = row;
+                if (plot->mode & OLED_PLOT_BARS) {
+                    bottom = plot->pages * 8 - 1;
+                } else if (col > 0) {
+                    uint8_t prev = D_PLOT_ROW(plot, col - 1);
+                    if (prev != 0xFF) {
+                        if (prev < top) top = prev;
+                        if (prev > bottom) bottom = prev;
+                    }
+                }
+                if (page >= top / 8 && page <= bottom / 8) bits = D_PAGE_BITS(page, top, bottom);
+            }
+            D_PUT(bits);
+        }
+    }
+    D_DATA_END();
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_PLOT_PUSH(OLED_PLOT *plot, int16_t value) {
+    if (plot->width == 0 || plot->pages == 0) return;
+    uint8_t height = plot->pages * 8;
+    if (value < plot->min) value = plot->min;
+    if (value > plot->max) value = plot->max;
+    uint8_t row = (height - 1) - ((int32_t)value - plot->min) * (height - 1) / ((int32_t)plot->max - plot->min);
+    uint8_t width = plot->width;
+    uint8_t slot = plot->next;
+    plot->rows[slot] = row;
+    plot->next = (slot + 1 < width) ? slot + 1 : 0;
+    if (plot->count < width) plot->count++;
+
+    uint8_t mode = plot->mode & ~OLED_PLOT_BARS;
+    if (mode == OLED_PLOT_SWEEP) {
+        if (plot->next > slot) D_PLOT_COLUMNS(plot, slot, plot->next);    // new column and the gap in one window
+        else {
+            D_PLOT_COLUMNS(plot, slot, slot);                   // cursor wraps to the left edge
+            if (width > 1) D_PLOT_COLUMNS(plot, 0, 0);
+        }
+        return;
+    }
+#if OLED_FRAMEBUFFER
+    for (uint8_t page = plot->page; page < plot->page + plot->pages; page++) {   // shift the area left in fb[]
+        uint8_t *line = &fb[page * disp_width + plot->x];
+        for (uint8_t col = 0; col + 1 < width; col++) {
+            if (line[col] != line[col + 1]) {
+                line[col] = line[col + 1];
+                FB_MARK(plot->x + col, page);
+            }
+        }
+    }
+    D_PLOT_COLUMNS(plot, width - 1, width - 1);
+#else
+    if (mode == OLED_PLOT_SCROLL) {
+        D_START_CMD();
+        D_TX(0x2D);                                             // content scroll left by one column
+        D_TX(0x00);                                             // dummy byte
+        D_TX(plot->page);                                       // start page
+        D_TX(0x01);                                             // dummy byte
+        D_TX(plot->page + plot->pages - 1);                     // end page
+        D_TX(plot->x + col_offset);                             // start column
+        D_TX(plot->x + width - 1 + col_offset);                 // end column
+        D_STOP();
+        D_PLOT_COLUMNS(plot, width - 1, width - 1);
+    } else {
+        D_PLOT_COLUMNS(plot, 0, width - 1);
+    }
+#endif
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_PLOT_REDRAW(OLED_PLOT *plot) {
+    if (plot->width && plot->pages) D_PLOT_COLUMNS(plot, 0, plot->width - 1);
+}
+
+// Text grid
+// D_GRID_CHAR / D_GRID_STR only mark the cells whose character really changes. D_GRID_FLUSH sends a run of
+// changed cells in a row with one position command and one data transaction; a single unchanged cell
+// between two changed ones is sent along (6 data bytes cost less than a new position). When the same
+// cells have changed in the rows below too, as after a clear or on a redrawn menu, the run is sent as one
+// window over all those rows. For fewer transactions still, put D_GRID_FLUSH in a batch.
+#define GRID_DIRTY(grid, row, col)      ((grid)->dirty[row][(col) >> 3] & (1 << ((col) & 7)))
+#define GRID_COLS                       (disp_width / 6)        // cells this panel shows (up to OLED_GRID_COLS)
+#define GRID_ROWS                       disp_pages
+
+void SSD1306_OLED_HW_I2C_LIB::D_GRID_INIT(OLED_GRID *grid) {
+    memset(grid->text, ' ', sizeof(grid->text));
+    memset(grid->dirty, 0xFF, sizeof(grid->dirty));         // display contents unknown
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_GRID_CLEAR(OLED_GRID *grid) {
+    for (uint8_t row = 0; row < GRID_ROWS; row++) {
+        for (uint8_t col = 0; col < GRID_COLS; col++) D_GRID_CHAR(grid, col, row, ' ');
+    }
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_GRID_CHAR(OLED_GRID *grid, uint8_t col, uint8_t row, char ch) {
+    if (col >= GRID_COLS || row >= GRID_ROWS || grid->text[row][col] == (uint8_t)ch) return;
+    grid->text[row][col] = ch;
+    grid->dirty[row][col >> 3] |= 1 << (col & 7);
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_GRID_STR(OLED_GRID *grid, uint8_t col, uint8_t row, const char *s, uint8_t attr) {
+    for (; *s && col < GRID_COLS; s++, col++) D_GRID_CHAR(grid, col, row, *s | attr);
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_GRID_FLUSH(OLED_GRID *grid) {
+    for (uint8_t row = 0; row < GRID_ROWS; row++) {
+        uint8_t col = 0;
+        while (col < GRID_COLS) {
+            if (!GRID_DIRTY(grid, row, col)) {
+                col++;
+                continue;
+            }
+            uint8_t first = col, last = col;
+            for (col++; col < GRID_COLS; col++) {           // extend the run, bridging one unchanged cell
+                if (GRID_DIRTY(grid, row, col)) last = col;
+                else if (col + 1 >= GRID_COLS || !GRID_DIRTY(grid, row, col + 1)) break;
+            }
+            uint8_t row_last = row;
+            for (uint8_t below = row + 1; below < GRID_ROWS; below++, row_last++) {         // same cells changed below?
+                uint8_t c = first;
+                while (c <= last && GRID_DIRTY(grid, below, c)) c++;
+                if (c <= last) break;
+            }
+            D_GRID_SEND(grid, first, last, row, row_last);
+        }
+    }
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_GRID_REDRAW(OLED_GRID *grid) {
+    memset(grid->dirty, 0xFF, sizeof(grid->dirty));
+    D_GRID_FLUSH(grid);
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_GRID_SEND(OLED_GRID *grid, uint8_t first, uint8_t last, uint8_t row, uint8_t row_last) {
+    if (row == row_last) {
+        D_SETPOS(first * 6, row);
+    } else {
+        D_WINDOW(first * 6, last * 6 + 5, row, row_last);
+        pos_lost = 1;
+    }
+    D_DATA_BEGIN();
+    for (uint8_t r = row; r <= row_last; r++) {
+        for (uint8_t c = first; c <= last; c++) {
+            uint8_t ch = grid->text[r][c];
+            uint8_t invert = (ch & OLED_GRID_INVERSE) ? 0xFF : 0x00;
+            for (uint8_t col = 0; col < 6; col++) D_PUT(D_GLYPH_COL(ch & ~OLED_GRID_INVERSE, col) ^ invert);
+            grid->dirty[r][c >> 3] &= ~(1 << (c & 7));
+        }
+    }
+    D_DATA_END();
+}
+
+// Frame animations
+// D_ANIM_TICK works out which frame is due from the time passed to it (e.g. millis()) and draws only
+// that one: frames that came due while the caller was busy or the bus was slow are skipped and counted
+// in anim->dropped, so the animation keeps its speed instead of lagging behind. In async mode a frame
+// is not queued while the previous one of the same animation is still in the queue (other traffic does
+// not hold it back, unless the queue went round since). Delta frames that are skipped are still
+// decoded into anim->shown, the XOR chain needs them, but nothing of them is sent.
+// anim->shown holds the frame on the display; only the columns that differ from it are sent, per page
+// or as one window over all changed pages, whichever is fewer bytes. In framebuffer mode the frame goes
+// into fb[] and D_FLUSH() sends it.
+#define ANIM_RAW                        0           // D_ANIM_APPLY: plain bitmap
+#define ANIM_RLE                        1           // RLE data replacing shown[]
+#define ANIM_RLE_XOR                    2           // RLE data XOR-ed onto shown[]
+#define ANIM_TX_COST                    10          // bus bytes of a window command and a data transaction header
+
+void SSD1306_OLED_HW_I2C_LIB::D_ANIM_START(OLED_ANIM *anim, const OLED_FRAMES *frames, uint8_t x, uint8_t page, uint16_t interval, uint8_t loop, uint32_t now) {
+    memcpy_P(&anim->frames, frames, sizeof(anim->frames));
+    if ((uint16_t)anim->frames.width * anim->frames.pages > OLED_ANIM_MAX || anim->frames.pages > disp_pages) {
+        anim->frames.count = 0;                                         // too large: not played
+    }
+    anim->x = x;
+    anim->page = page;
+    anim->loop = loop;
+    anim->index = 0;
+    anim->next = anim->frames.data;
+    anim->start = now;
+    anim->played = 0;
+    anim->interval = interval ? interval : 1;
+    anim->dropped = 0;
+#if OLED_ASYNC
+    anim->queued = q_tail;                                              // nothing of it in the queue
+#endif
+}
+
+uint8_t SSD1306_OLED_HW_I2C_LIB::D_ANIM_TICK(OLED_ANIM *anim, uint32_t now) {
+    uint8_t count = anim->frames.count;
+    if (count == 0) return 0;
+    uint32_t due = (now - anim->start) / anim->interval + 1;           // frames that should have been shown by now
+    if (!anim->loop && due > count) due = count;
+    if (due <= anim->played) return anim->loop || anim->played < count;
+#if OLED_ASYNC && !OLED_FRAMEBUFFER
+    Q_REPORT();
+    if (Q_PENDING(anim->queued)) return 1;                              // its previous frame still queued: catch up later
+#endif
+
+    uint8_t lo[OLED_PAGES], hi[OLED_PAGES];                             // changed columns of each page
+    uint8_t last_col = anim->frames.width - 1;
+    for (uint8_t p = 0; p < disp_pages; p++) {
+        lo[p] = (anim->played == 0) ? 0 : 0xFF;                         // first frame: the area is unknown, send it all
+        hi[p] = (anim->played == 0) ? last_col : 0;
+    }
+    uint8_t target = (due - 1) % count;
+    if (anim->frames.format == OLED_FRAMES_DELTA) {
+        uint8_t index = anim->index;
+        if (anim->played == 0 || (due - 1) / count != (anim->played - 1) / count) {  // (again) from frame 0
+            anim->next = D_ANIM_APPLY(anim, anim->frames.data, ANIM_RLE, lo, hi);
+            index = 0;
+        }
+        for (; index != target; index++) anim->next = D_ANIM_APPLY(anim, anim->next, ANIM_RLE_XOR, lo, hi);
+    } else {
+        D_ANIM_APPLY(anim, anim->frames.data + (uint16_t)target * anim->frames.width * anim->frames.pages, ANIM_RAW, lo, hi);
+    }
+    anim->dropped += due - anim->played - 1;
+    anim->played = due;
+    anim->index = target;
+    D_ANIM_SEND(anim, lo, hi);
+    return anim->loop || due < count;
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_ANIM_REDRAW(OLED_ANIM *anim) {
+    if (anim->played == 0) return;                                      // nothing shown yet
+    uint8_t lo[OLED_PAGES], hi[OLED_PAGES];
+    for (uint8_t p = 0; p < disp_pages; p++) {
+        lo[p] = 0;
+        hi[p] = anim->frames.width - 1;
+    }
+    D_ANIM_SEND(anim, lo, hi);
+}
+
+const uint8_t *SSD1306_OLED_HW_I2C_LIB::D_ANIM_APPLY(OLED_ANIM *anim, const uint8_t *src, uint8_t mode, uint8_t *lo, uint8_t *hi) {
+    uint8_t *shown = anim->shown;
+    uint8_t run = 0, literal = 0, value = 0;                // RLE decoder state
+    for (uint8_t p = 0; p < anim->frames.pages; p++) {
+        for (uint8_t col = 0; col < anim->frames.width; col++, shown++) {
+            uint8_t data;
+            if (mode == ANIM_RAW) {
+                data = pgm_read_byte(src++);
+            } else {
+                if (run == 0) {                             // next control byte
+                    uint8_t n = pgm_read_byte(src++);
+                    literal = (n < 0x80);
+                    run = literal ? n + 1 : n - 0x7E;
+                    if (!literal) value = pgm_read_byte(src++);
+                }
+                data = literal ? pgm_read_byte(src++) : value;
+                run--;
+                if (mode == ANIM_RLE_XOR) data ^= *shown;
+            }
+            if (data == *shown) continue;
+            *shown = data;
+            if (col < lo[p]) lo[p] = col;
+            if (col > hi[p]) hi[p] = col;
+        }
+    }
+    return src;
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_ANIM_SEND(OLED_ANIM *anim, const uint8_t *lo, const uint8_t *hi) {
+    if (anim->x >= disp_width || anim->page >= disp_pages) return;
+    uint8_t visible = disp_width - anim->x;                             // columns on the screen
+    uint8_t pages = anim->frames.pages;
+    if (pages > disp_pages - anim->page) pages = disp_pages - anim->page;
+    uint8_t ulo = 0xFF, uhi = 0, p0 = 0xFF, p1 = 0;
+    uint16_t cost = 0;                                                  // bytes on the bus, page by page
+    for (uint8_t p = 0; p < pages; p++) {
+        if (lo[p] > hi[p] || lo[p] >= visible) continue;
+        uint8_t h = (hi[p] >= visible) ? visible - 1 : hi[p];
+        cost += h - lo[p] + 1 + ANIM_TX_COST;
+        if (lo[p] < ulo) ulo = lo[p];
+        if (h > uhi) uhi = h;
+        if (p0 == 0xFF) p0 = p;
+        p1 = p;
+    }
+    if (p0 == 0xFF) return;                                             // nothing changed
+    if ((uint16_t)(uhi - ulo + 1) * (p1 - p0 + 1) + ANIM_TX_COST <= cost) {
+        D_ANIM_AREA(anim, ulo, uhi, p0, p1);                            // one window is cheaper
+        return;
+    }
+    for (uint8_t p = p0; p <= p1; p++) {
+        if (lo[p] > hi[p] || lo[p] >= visible) continue;
+        D_ANIM_AREA(anim, lo[p], (hi[p] >= visible) ? visible - 1 : hi[p], p, p);
+    }
+}
+
+void SSD1306_OLED_HW_I2C_LIB::D_ANIM_AREA(OLED_ANIM *anim, uint8_t lo, uint8_t hi, uint8_t p0, uint8_t p1) {   // columns lo-hi of pages p0-p1
+    D_WINDOW(anim->x + lo, anim->x + hi, anim->page + p0, anim->page + p1);
+    D_DATA_BEGIN();
+    for (uint8_t p = p0; p <= p1; p++) {
+        const uint8_t *row = &anim->shown[p * anim->frames.width];
+        for (uint8_t col = lo; col <= hi; col++) D_PUT(row[col]);
+    }
+    D_DATA_END();
+#if OLED_ASYNC && !OLED_FRAMEBUFFER
+    anim->queued = q_wr;
+#endif
+    pos_lost = 1;
 }
 
 void SSD1306_OLED_HW_I2C_LIB::D_DEMO(void) {                                         // display demonstration 
         D_CLEAR();                                          // clear display
-        D_DRAW_HOR(0, 0, 127);                              // top horiz line (start x, start y, length)
-        D_DRAW_HOR(0, 63, 127);                             // bottom horiz line (start x, start y, length)
-        D_DRAW_VERT(0, 0, 64);                              // left vert line (start x, start y, length)
-        D_DRAW_VERT(127, 0, 64);                            // right vert line (start x, start y, length)
+        D_DRAW_HOR(0, 0, disp_width - 1);                   // top horiz line (start x, start y, length)
+        D_DRAW_HOR(0, disp_height - 1, disp_width - 1);     // bottom horiz line (start x, start y, length)
+        D_DRAW_VERT(0, 0, disp_height);                     // left vert line (start x, start y, length)
+        D_DRAW_VERT(disp_width - 1, 0, disp_height);        // right vert line (start x, start y, length)
         D_SETPOS(25,1);                                     // set cursor position
-        D_PRINT_STR("DEMONSTRATION");                       // print message
+        D_PRINT_STR_P(PSTR("DEMONSTRATION"));               // print message (string kept in flash)
         D_SETPOS(6,3);
-        D_PRINT_STR("The display will be");
+        D_PRINT_STR_P(PSTR("The display will be"));
         D_SETPOS(34,4);
-        D_PRINT_STR("turned off");
+        D_PRINT_STR_P(PSTR("turned off"));
         D_SETPOS(30,5);
-        D_PRINT_STR("temporarily");
+        D_PRINT_STR_P(PSTR("temporarily"));
+        D_FLUSH();                                          // send the screen (framebuffer mode)
         _delay_ms(2000);
         D_OFF();                                            // turn off display (conserve power)
         _delay_ms(500);
         D_CLEAR();
+        D_FLUSH();
         D_ON();                                             // turn on display
         _delay_ms(500);
 
         D_SETPOS(2,3);
-        D_PRINT_STR("   Counter = ");
+        D_PRINT_STR_P(PSTR("   Counter = "));
+        OLED_FIELD counter;
+        D_FIELD_INIT(&counter, 2+13*6, 3, 3);
         for (uint16_t i = 800; i>0; i--) {
-            D_SETPOS(2+13*6,3);
-            D_PRINT_INT(i);                                 // print counter variable
+            D_FIELD_UINT(&counter, i);                      // print counter variable (changed digits only)
+            D_FLUSH();
         }
     
         D_CLEAR();
         D_SETPOS(18,4);
-        D_PRINT_STR("LOWEST CONTRAST");
+        D_PRINT_STR_P(PSTR("LOWEST CONTRAST"));
+        D_FLUSH();
         _delay_ms(1000);
         D_CONTRAST(0xFF);                                   // change contrast (0-255 or 0x00-0xFF)
         D_SETPOS(14,4);
-        D_PRINT_STR("HIGHEST CONTRAST");
+        D_PRINT_STR_P(PSTR("HIGHEST CONTRAST"));
+        D_FLUSH();
         _delay_ms(1000);
         D_CONTRAST(0x00);
 }
@@ -7,18 +7,71 @@
 
 This library is designed to control a 128x64 OLED display with an SSD1306 controller over I2C. In essence, it is a minimalistic adaptation of a library written for ATTiny85 and similar micro-controllers. The purpose of this adaptation is to reduce the memory footprint, and add hardware support for I2C communication (supported on ATmega328P, ATmega32U4 and some other micro-controllers). The library can be used with Arduino IDE or in a plain C environment.
 
+Other panel sizes (e.g. 128x32, 64x48) and the I2C address are set per instance, so different panels can be driven side by side: SSD1306_OLED_HW_I2C_LIB lcd2(0, 0x3D, 64, 48);
+Displays with the same address can sit behind a TCA9548A I2C multiplexer, see D_SET_MUX(). All instances share the bus, and D_FLUSH_ALL() sends their framebuffer changes page by page in turn.
+Besides the AVR TWI hardware the library can use the Arduino Wire library (SAMD, RP2040, STM32, ...) or a 4-wire SPI panel through the SPI library, see OLED_TRANSPORT in SSD1306_OLED_HW_I2C_LIB.h.
+
 The following functions have been implemented in the library:
    - initialize display				D_INIT();
+   - re-initialize after a power glitch		D_REINIT_FAST();	// only registers that differ from reset, then the framebuffer
    - clear display					D_CLEAR();
+   - fill screen with a byte pattern		D_FILL(pattern);  // 0x00 = clear, 0xFF = all on, 0x55 = stripes
+   - fill area with a byte pattern		D_FILL_RECT(x [0-127], page [0-7], width, pages, pattern);
+   - blank without clearing GDDRAM		D_BLANK(OLED_BLANK_DARK / OLED_BLANK_LIT / OLED_BLANK_OFF);
    - turn off (sleep)					D_OFF();
    - turn on (wake up)					D_ON();
+   - dim / power down when idle			D_SET_IDLE(dim after, off after, dim contrast); D_IDLE_TICK(millis());
+   - undo idle dimming / power down		D_WAKE();	// also done by the next draw
+   - idle manager state				D_POWER();	// OLED_POWER_ON / _DIM / _OFF
    - change brightness (same as contrast)		D_CONTRAST (0-255 or 0x00-0xFF);	
    - set position					D_SETPOS(x coordinate [0-127], character row [0-7]);	// (0,0) corresponds to the upper left corner, 
    - print string (8x6 ascii font)			D_PRINT_STR(“string”);
+   - print string from flash			D_PRINT_STR_P(PSTR("string"));
+   - formatted output, no buffer			D_PRINTF("%5u rpm", rpm); D_PRINTF_P(PSTR("%S: %d"), name_P, value);
+   - stream text in one transaction		D_PRINT_BEGIN(); ... D_PRINT_END();	// also print() / println() (Arduino Print)
+   - select font (PROGMEM OLED_FONT descriptor)	D_SET_FONT(&OLED_FONT_6x8);
+   - width of a string in pixels			D_TEXT_WIDTH("string");
+   - print string 2x / 4x / 8x as large		D_PRINT_STR_SCALED("string", scale);
+   - text size of D_PRINT_*			D_SET_SCALE(1 / 2 / 4 / 8);
    - print variable(integers only)			D_PRINT_INT(integer or int variable);
+   - print unsigned, zero/space padded		D_PRINT_UINT(value, width, pad);
+   - print signed, zero/space padded		D_PRINT_SINT(value, width, pad);
+   - print hexadecimal				D_PRINT_HEX(value, digits);
+   - print fixed point (-1234,2 -> -12.34)	D_PRINT_FIXED(value, decimals, width, pad);
+   - numeric field (redraws changed digits)		D_FIELD_INIT(&field, x, row, width); D_FIELD_UINT(&field, value); D_FIELD_SINT(&field, value);
+   - rolling plot (sends the new column only)	D_PLOT_INIT(&plot, x, page, width, pages, min, max, OLED_PLOT_SCROLL); D_PLOT_PUSH(&plot, value); D_PLOT_REDRAW(&plot);
+   - text grid of 6x8 cells (sends changed cells)	D_GRID_INIT(&grid); D_GRID_STR(&grid, col, row, "text", OLED_GRID_INVERSE); D_GRID_FLUSH(&grid);
+   - frame animation (PROGMEM, XOR deltas)		D_ANIM_START(&anim, &frames, x, page, interval, loop, millis()); D_ANIM_TICK(&anim, millis());	// late frames are skipped
    - draw horizontal line				D_DRAW_HOR(starting x coordinate [0-127], starting y coordinate [0-63], length);
    - draw vertical line				D_DRAW_VERT(starting x coordinate [0-127], starting y coordinate [0-63], length);
+   - draw filled rectangle				D_DRAW_BOX(x [0-127], y [0-63], width, height);
+   - draw rectangle outline				D_DRAW_FRAME(x [0-127], y [0-63], width, height);
+   - drawing mode of lines, boxes and shapes	D_SET_DRAW_MODE(OLED_DRAW_SET / OLED_DRAW_CLEAR / OLED_DRAW_INVERT);	// framebuffer mode
+   - set / read a pixel (framebuffer mode)		D_PIXEL(x, y); D_GET_PIXEL(x, y);
+   - draw line at any angle (framebuffer mode)	D_LINE(x0, y0, x1, y1);
+   - draw circle (framebuffer mode)		D_CIRCLE(x, y, radius); D_FILL_CIRCLE(x, y, radius);
+   - draw bitmap (page-major, from PROGMEM)		D_DRAW_BITMAP(x [0-127], page [0-7], width, pages, bitmap);  // _RAM: from SRAM, _RLE: run-length encoded
    - demonstration mode				D_DEMO();
+   - hardware horizontal scroll			D_SCROLL_H(left [0/1], start page, end page, speed [OLED_SCROLL_*]);
+   - hardware diagonal scroll			D_SCROLL_DIAG(left [0/1], start page, end page, speed, rows per step);
+   - stop hardware scroll			D_SCROLL_STOP();
+   - set display start line			D_START_LINE(row [0-63]);
+   - scrolling text console			D_CONSOLE_CLEAR(); D_CONSOLE_LINE(“text”);
+   - set I2C clock frequency			D_SET_CLOCK(Hz);	// or SSD1306_OLED_HW_I2C_LIB lcd(400000);
+   - find fastest working I2C clock		D_TUNE_CLOCK(min Hz, max Hz);
+   - set I2C error handler			D_ON_ERROR(function(uint8_t status));	// default: ERROR_PIN on PORTD is lit
+   - do other work during long transfers		D_ON_YIELD(function(void), every n bytes);	// interrupts stay enabled while sending
+   - read and clear last I2C error		D_STATUS();
+   - bus counters (with OLED_STATS 1)		D_GET_STATS(&stats); D_RESET_STATS();
+   - set I2C start retries			D_SET_RETRIES(count);
+   - display behind a TCA9548A I2C mux		D_SET_MUX(mux address [0x70-0x77], channel [0-7]);
+   - send framebuffer changes (framebuffer mode)	D_FLUSH();
+   - flush all displays, a page each in turn	SSD1306_OLED_HW_I2C_LIB::D_FLUSH_ALL();	// D_FLUSH_STEP(): one page per call
+   - show back buffer (double buffering)		D_SWAP();
+   - merge transactions (Co=1, repeated START)	D_BATCH_BEGIN(); ... D_BATCH_END();
+   - check for pending transfers (async mode)		D_BUSY();
+   - wait for pending transfers (async mode)		D_WAIT();
+   - wait in MCU idle sleep (async mode)		D_SLEEP_WAIT();
 
 Note: even though it is possible to specify the exact y coordinate in D_DRAW_HOR, 8 adjacent pixel rows will be rendered (but only one of these rows will light up). As a result any text that was printed in the same group of rows will be overwritten. For example, the following code will result in the line completely erasing the text because pixel rows 0-6 will be rendered dark:
 
@@ -26,6 +79,8 @@ D_SETPOS(0, 1);
 D_PRINT_STR(“some text”);
 D_DRAW_HOR(0, 7, 128);
 
+This does not apply when the library is built with OLED_FRAMEBUFFER set to 1: lines are then OR-ed into a RAM copy of the display (or cleared / inverted, see D_SET_DRAW_MODE), and D_FLUSH() sends only the columns that changed. D_PIXEL, D_LINE and the circles need the framebuffer.
+
 
 Below are credits from the original SSD1306 library:
 
@@ -51,46 +106,664 @@ Below are credits from the original SSD1306 library:
 #define OLED_CMD_SET_COLUMN_RANGE       0x21        // can be used only in HORZ/VERT mode - follow with 0x00 and 0x7F = COL127
 #define OLED_CMD_SET_PAGE_RANGE         0x22        // can be used only in HORZ/VERT mode - follow with 0x00 and 0x07 = PAGE7
 
-#define SLA_W                           0x78        // slave address + 0
+#define SLA_W                           0x78        // default slave address + 0 (0x3C), 0x7A for 0x3D
 #define ERROR_PIN                       4           // LED pin to indicate I2C error (2-7)
 
-#define USINT2DECASCII_MAX_DIGITS 5
+// I2C error handling
+// Status codes returned by the transaction primitives and D_STATUS(), and passed to the D_ON_ERROR() handler
+#define OLED_OK                         0
+#define OLED_ERR_START                  1           // START not sent (bus busy, arbitration lost)
+#define OLED_ERR_ADDR                   2           // slave address not ACKed (no display)
+#define OLED_ERR_DATA                   3           // data byte not ACKed
+#define OLED_ERR_TIMEOUT                4           // TWI did not respond in time (bus stuck)
+
+#ifndef OLED_TWI_TIMEOUT
+#define OLED_TWI_TIMEOUT                4000        // polls of TWINT before a TWI step is given up (~1.5 ms at 16 MHz)
+#endif
+#ifndef OLED_RETRIES
+#define OLED_RETRIES                    2           // times a transaction start is retried before reporting an error
+#endif
+
+// Hardware scroll speed (frames per scroll step) for D_SCROLL_H / D_SCROLL_DIAG
+#define OLED_SCROLL_2_FRAMES            0x07
+#define OLED_SCROLL_3_FRAMES            0x04
+#define OLED_SCROLL_4_FRAMES            0x05
+#define OLED_SCROLL_5_FRAMES            0x00
+#define OLED_SCROLL_25_FRAMES           0x06
+#define OLED_SCROLL_64_FRAMES           0x01
+#define OLED_SCROLL_128_FRAMES          0x02
+#define OLED_SCROLL_256_FRAMES          0x03
+
+// Batching (D_BATCH_BEGIN / D_BATCH_END)
+#ifndef OLED_BATCH_MERGE
+#define OLED_BATCH_MERGE                3           // longest command run sent with Co=1 prefixes in front of data
+#endif
+#define BATCH_NONE                      0
+#define BATCH_CMD                       1
+#define BATCH_DATA                      2
+
+// D_BLANK modes
+#define OLED_BLANK_OFF                  0           // show GDDRAM
+#define OLED_BLANK_DARK                 1           // panel off (0xAE), GDDRAM kept
+#define OLED_BLANK_LIT                  2           // all pixels on (0xA5), GDDRAM kept
+
+// D_SET_DRAW_MODE modes (framebuffer mode)
+#define OLED_DRAW_SET                   0           // light the pixels (OR)
+#define OLED_DRAW_CLEAR                 1           // darken them (AND NOT)
+#define OLED_DRAW_INVERT                2           // flip them (XOR), drawing twice restores the picture
+
+// Power
+// OLED_CHARGE_PUMP selects the panel supply: 1 = internal charge pump (modules without a VCC pin),
+// 0 = external VCC. OLED_PRECHARGE is the 0xD9 setting (phase 2 in the high, phase 1 in the low nibble).
+#ifndef OLED_CHARGE_PUMP
+#define OLED_CHARGE_PUMP                1
+#endif
+#ifndef OLED_PRECHARGE
+#define OLED_PRECHARGE                  0x22
+#endif
+// States of the idle manager (D_SET_IDLE / D_IDLE_TICK)
+#define OLED_POWER_ON                   0
+#define OLED_POWER_DIM                  1           // contrast lowered
+#define OLED_POWER_OFF                  2           // panel off (0xAE), charge pump off, GDDRAM kept
+
+// Display geometry
+// Each instance gets its panel size from the constructor, so a 128x64 and a 64x48 display can share a build:
+// SSD1306_OLED_HW_I2C_LIB small(0, 0x3D, 64, 48);  Common panels: 128x64, 128x32, 64x48.
+// OLED_WIDTH / OLED_HEIGHT are the largest panel in the build (they size the framebuffer and OLED_GRID)
+// and the default for instances created without a size.
+#ifndef OLED_WIDTH
+#define OLED_WIDTH                      128         // columns (pixels)
+#endif
+#ifndef OLED_HEIGHT
+#define OLED_HEIGHT                     64          // rows (pixels): 64, 48, 32 or 16
+#endif
+#define OLED_PAGES                      (OLED_HEIGHT / 8)
+#define OLED_COL_AUTO                   0xFF        // first GDDRAM column from the width (64 wide panels use 32-95)
+#ifndef OLED_COL_OFFSET
+#define OLED_COL_OFFSET                 OLED_COL_AUTO   // default first GDDRAM column of an instance
+#endif
+// OLED_COM_PINS (0xDA setting), if defined, replaces the one derived from the height for all instances:
+// 0x12 = alternative COM (64 and 48 rows), 0x02 = sequential COM (32 and 16 rows).
+// With OLED_FIXED_GEOMETRY set to 1 every instance is an OLED_WIDTH x OLED_HEIGHT panel with OLED_INIT_PROFILE
+// and the constructor only takes the clock and address: geometry and profile are then compile-time constants,
+// so ranges and loop bounds fold and the unused init table is left out. Single-panel builds save flash this way.
+#ifndef OLED_FIXED_GEOMETRY
+#define OLED_FIXED_GEOMETRY             0           // 0 = geometry per instance (constructor), 1 = one geometry for all
+#endif
+
+// Initialization profile
+// The PROGMEM command table D_INIT sends, chosen per instance (constructor). Both set up the geometry of the
+// instance and horizontal addressing. The oscillator (0xD5) and V_COMH (0xDB) follow the profile; defining
+// OLED_OSC / OLED_VCOMH sets them for all instances, like OLED_COM_PINS.
+#define OLED_PROFILE_STANDARD           0           // every register set explicitly (the original sequence)
+#define OLED_PROFILE_SHORT              1           // fewer commands, reset oscillator, higher V_COMH
+#ifndef OLED_INIT_PROFILE
+#define OLED_INIT_PROFILE               OLED_PROFILE_STANDARD   // profile of instances created without one
+#endif
+
+// Interrupt-driven transmission (optional)
+// With OLED_ASYNC set to 1 the D_* functions do not talk to the TWI hardware directly. Every transaction
+// (control byte + payload) is framed into a ring buffer in SRAM and sent in the background by the TWI_vect
+// interrupt, so the calls return as soon as the bytes are queued and interrupts are never disabled.
+// A call only waits when the queue is full. Use D_BUSY() / D_WAIT() to check for / wait for completion.
+#ifndef OLED_ASYNC
+#define OLED_ASYNC                      0           // 0 = blocking (polled) TWI, 1 = interrupt-driven TWI
+#endif
+#ifndef OLED_QUEUE_SIZE
+#define OLED_QUEUE_SIZE                 128         // size of the transmit queue in bytes (power of 2, 8-256)
+#endif
+
+// Framebuffer (optional)
+// With OLED_FRAMEBUFFER set to 1 the library keeps a 1 KB copy of the display RAM. D_CLEAR, D_SETPOS,
+// D_PRINT_* and D_DRAW_* only change that copy (lines no longer erase the other 7 rows of their page)
+// and nothing is sent until D_FLUSH(), which transmits only the columns changed on each page.
+#ifndef OLED_FRAMEBUFFER
+#define OLED_FRAMEBUFFER                0           // 0 = draw directly over I2C, 1 = draw into RAM and D_FLUSH()
+#endif
+
+// Double buffering (optional, needs OLED_FRAMEBUFFER)
+// With OLED_DOUBLE_BUFFER set to 1 there are two RAM copies. D_SWAP() (or D_FLUSH()) makes the frame just
+// drawn the front buffer, sends the columns that differ from the previous frame and continues drawing on
+// a copy of it. In async mode the front buffer is sent straight from SRAM by the ISR, so D_SWAP() returns
+// at once and the next frame is rendered while this one is on the bus; D_SWAP() only waits for the previous
+// frame. On panels of up to 32 rows the frames alternate between the two halves of GDDRAM and the start
+// line is switched once a frame is complete, so a half-sent frame is never shown (OLED_PAGE_FLIP).
+// Needs 2 x OLED_WIDTH x OLED_PAGES bytes of SRAM: 1 KB at 128x32, too much for an ATmega328 at 128x64.
+#ifndef OLED_DOUBLE_BUFFER
+#define OLED_DOUBLE_BUFFER              0           // 0 = one framebuffer, 1 = render into a back buffer and D_SWAP()
+#endif
+#ifndef OLED_PAGE_FLIP
+#define OLED_PAGE_FLIP                  (OLED_HEIGHT <= 32)     // swap through the display start line (double buffering)
+#endif
+
+// Bus transport
+// On an AVR the library drives the TWI hardware itself. Other Arduino cores (SAMD, RP2040, STM32, ...) go
+// through the Wire library, and SPI variants of the panel (4-wire: D/C# and CS pins) through the SPI library;
+// the drawing code is the same for all of them. Compiled for a PC the library runs against an SSD1306
+// emulator instead (SSD1306_OLED_HOST.h), which decodes the command / data stream into a GDDRAM model for
+// tests and benchmarks. Async mode (OLED_ASYNC) needs the TWI hardware (the emulator models it).
+#define OLED_TRANSPORT_TWI              0           // AVR TWI (ATmega328P, ATmega32U4, ATmega2560, ...)
+#define OLED_TRANSPORT_HOST             1           // emulated display on the build host (blocking mode only)
+#define OLED_TRANSPORT_WIRE             2           // Arduino Wire library, any core (blocking mode only)
+#define OLED_TRANSPORT_SPI              3           // Arduino SPI library, 4-wire SPI panel (blocking mode only)
+#ifndef OLED_TRANSPORT
+#if defined(__AVR__)
+#define OLED_TRANSPORT                  OLED_TRANSPORT_TWI
+#elif defined(ARDUINO)
+#define OLED_TRANSPORT                  OLED_TRANSPORT_WIRE
+#else
+#define OLED_TRANSPORT                  OLED_TRANSPORT_HOST
+#endif
+#endif
+#ifndef OLED_WIRE_BUFFER
+#define OLED_WIRE_BUFFER                32          // Wire transmit buffer size (BUFFER_LENGTH, 32 on most cores)
+#endif
+#ifndef OLED_SPI_CS
+#define OLED_SPI_CS                     10          // chip select pin
+#endif
+#ifndef OLED_SPI_DC
+#define OLED_SPI_DC                     9           // D/C# pin: low = command, high = data
+#endif
+#ifndef OLED_SPI_RES
+#define OLED_SPI_RES                    8           // reset pin, pulsed by D_INIT (-1 = not connected)
+#endif
+#ifndef OLED_SPI_CLOCK
+#define OLED_SPI_CLOCK                  8000000     // SPI clock in Hz, unless given to the constructor (max 10 MHz)
+#endif
+// Framebuffer pages and RAM bitmaps are sent with one bulk write. Over SPI it defaults to a byte loop;
+// cores with a non-destructive or DMA block transfer can plug it in here, e.g. on the RP2040:
+//   #define OLED_SPI_WRITE_BLOCK(src, count)   SPI.transfer(src, NULL, count)
+
+// Interrupts (blocking mode)
+// The TWI hardware holds SCL low after each byte until the next one is written, so a transaction may be
+// interrupted at any point: interrupts stay enabled while the library sends, and a UART or timer ISR is
+// not held up by a D_CLEAR(). With OLED_IRQ_OFF set to 1 they are disabled from START to STOP as in
+// earlier versions, and afterwards restored to what they were (SREG) rather than enabled. Cooperative
+// work during long transfers can be hooked in with D_ON_YIELD().
+#ifndef OLED_IRQ_OFF
+#define OLED_IRQ_OFF                    0           // 1 = disable interrupts for every transaction
+#endif
+
+// Bus statistics (optional)
+// With OLED_STATS set to 1 the TWI layer counts what goes over the bus (all instances together), see
+// D_GET_STATS(). The time spent waiting is counted in polls of TWINT; for time in clock ticks define
+// OLED_STATS_CLOCK() as a read of a free-running 16-bit timer, e.g. TCNT1 with Timer 1 at F_CPU / 1
+// (single waits must then be shorter than one timer period).
+#ifndef OLED_STATS
+#define OLED_STATS                      0           // 0 = no counters, 1 = count transactions, bytes, errors and waits
+#endif
+
+// Glyph cache (optional)
+// With OLED_GLYPH_CACHE set to 1, D_SET_FONT copies the glyphs of the characters OLED_GLYPH_CACHE_FIRST to
+// OLED_GLYPH_CACHE_LAST of a single-page font to SRAM, already padded with the font's spacing, and text and
+// numeric fields send them with one block write per character instead of a PROGMEM read per column.
+// RAM: (LAST - FIRST + 1) * (OLED_GLYPH_CACHE_COLS + 1) bytes per instance, 98 for the default set.
+#ifndef OLED_GLYPH_CACHE
+#define OLED_GLYPH_CACHE                0
+#endif
+#ifndef OLED_GLYPH_CACHE_FIRST
+#define OLED_GLYPH_CACHE_FIRST          '-'         // default set: - . / 0-9 :
+#endif
+#ifndef OLED_GLYPH_CACHE_LAST
+#define OLED_GLYPH_CACHE_LAST           ':'
+#endif
+#ifndef OLED_GLYPH_CACHE_COLS
+#define OLED_GLYPH_CACHE_COLS           6           // columns per cached glyph, spacing included (wider ones stay in PROGMEM)
+#endif
+
+// Print interface
+// With OLED_PRINT set to 1 (the default in the Arduino IDE) the class is an Arduino Print, so lcd.print(x),
+// lcd.println(F("text")) and anything else that writes to a Print & draw on the display in the current font.
+// It costs a vtable pointer per instance and the Print vtable in SRAM. D_PRINTF is available either way.
+#ifndef OLED_PRINT
+#if defined(ARDUINO)
+#define OLED_PRINT                      1
+#else
+#define OLED_PRINT                      0
+#endif
+#endif
 
 
 #include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#if OLED_PRINT
+#include <Print.h>
+#endif
 
 
-class SSD1306_OLED_HW_I2C_LIB {
+// Font descriptor (kept in PROGMEM, see D_SET_FONT)
+// Glyph columns are bytes of 8 vertical pixels (bit 0 on top); a glyph of a font that is 'pages' high is
+// stored page by page. Proportional fonts list the first column of each glyph in 'offsets'.
+struct OLED_FONT {
+    const uint8_t *bitmap;                          // glyph columns in PROGMEM
+    const uint16_t *offsets;                        // PROGMEM, last - first + 2 entries, or 0 for a fixed-width font
+    uint8_t first;                                  // first character in the font
+    uint8_t last;                                   // last character in the font
+    uint8_t width;                                  // columns per glyph (fixed width), or of characters not in the font
+    uint8_t pages;                                  // height in pages (8 pixel rows)
+    uint8_t spacing;                                // blank columns in front of every glyph
+};
+
+struct OLED_BUS_STATS {
+    uint32_t transactions;                          // START and repeated START conditions
+    uint32_t bytes;                                 // bytes ACKed after the address (control bytes and data)
+    uint16_t nacks;                                 // address or data byte not ACKed
+    uint16_t retries;                               // transaction starts repeated after a failure
+    uint16_t timeouts;                              // TWI steps or the ISR given up (bus stuck)
+    uint32_t wait_polls;                            // blocking: TWINT polls, async: polls for queue space / D_WAIT
+    uint32_t wait_time;                             // OLED_STATS_CLOCK ticks spent polling TWINT (blocking)
+    uint32_t irq_off_time;                          // OLED_STATS_CLOCK ticks with interrupts disabled (OLED_IRQ_OFF)
+};
+
+extern const OLED_FONT OLED_FONT_6x8;               // built-in 5x7 font, ' ' to '~', 6 pixels per character
+
+// Numeric field
+// A right-aligned number at a fixed position, in the current font. D_FIELD_UINT / D_FIELD_SINT remember what
+// is on the display and only send the glyph columns that changed, so a counter ticking 799 -> 798 costs a few bytes.
+#define OLED_FIELD_MAX                  11          // maximum field width in characters
+
+struct OLED_FIELD {
+    uint8_t x;                                      // left edge (pixels)
+    uint8_t page;                                   // character row (top page of taller fonts)
+    uint8_t width;                                  // characters, numbers that do not fit show as ####
+    char text[OLED_FIELD_MAX];                      // characters currently shown (0 = unknown)
+};
+
+// Plots (D_PLOT_*)
+#ifndef OLED_PLOT_MAX
+#define OLED_PLOT_MAX                   64          // maximum plot width in columns (one byte of RAM each)
+#endif
+#define OLED_PLOT_SWEEP                 0           // new sample at a moving cursor, a blank column ahead of it
+#define OLED_PLOT_SCROLL                1           // graph moves left: hardware content scroll (0x2D) + new column
+#define OLED_PLOT_REDRAW                2           // graph moves left, redrawn whole (panels without 0x2C/0x2D)
+#define OLED_PLOT_BARS                  0x80        // flag: fill each column down to the bottom instead of a line
+
+struct OLED_PLOT {
+    uint8_t x;                                      // left edge (pixels)
+    uint8_t page;                                   // top page
+    uint8_t width;                                  // columns, one sample each
+    uint8_t pages;                                  // height in pages
+    uint8_t mode;                                   // OLED_PLOT_SWEEP / _SCROLL / _REDRAW, | OLED_PLOT_BARS
+    int16_t min, max;                               // values shown at the bottom / top row
+    uint8_t count;                                  // samples so far (up to width)
+    uint8_t next;                                   // slot of the next sample in rows[]
+    uint8_t rows[OLED_PLOT_MAX];                    // pixel row of each sample (0 = top of the plot)
+};
+
+// Text grid (D_GRID_*)
+// The screen as a grid of 6x8 cells of the built-in font, one byte per cell plus a change bit: 192 bytes on
+// a 128x64 panel where a framebuffer needs 1 KB. Drawing into the grid sends nothing, D_GRID_FLUSH sends
+// the cells that changed since the last flush.
+// Sized for the largest panel of the build; an instance only uses the cells its own panel shows.
+#define OLED_GRID_COLS                  (OLED_WIDTH / 6)        // 21 on a 128 pixel wide panel
+#define OLED_GRID_ROWS                  OLED_PAGES
+#define OLED_GRID_INVERSE               0x80        // or-ed into a character: cell drawn inverted (e.g. menu cursor)
+
+struct OLED_GRID {
+    uint8_t text[OLED_GRID_ROWS][OLED_GRID_COLS];   // character of each cell (| OLED_GRID_INVERSE)
+    uint8_t dirty[OLED_GRID_ROWS][(OLED_GRID_COLS + 7) / 8];   // cells changed since the last D_GRID_FLUSH
+};
+
+// Frame animations (D_ANIM_*)
+// A sequence of equally sized page-major frames in PROGMEM (OLED_FRAMES, the layout of D_DRAW_BITMAP),
+// played at a fixed frame interval by D_ANIM_TICK(). OLED_FRAMES_DELTA frames are each stored as the XOR
+// of the frame and the one before it (the first one against a blank area), run-length encoded like
+// D_DRAW_BITMAP_RLE, so the parts that stay the same shrink to runs of zeros.
+#ifndef OLED_ANIM_MAX
+#define OLED_ANIM_MAX                   128         // maximum frame size in bytes (width * pages, 32x32 pixels)
+#endif
+#define OLED_FRAMES_RAW                 0           // plain bitmaps, width * pages bytes each
+#define OLED_FRAMES_DELTA               1           // RLE-encoded XOR deltas
+
+struct OLED_FRAMES {                                // frame sequence (descriptor kept in PROGMEM)
+    const uint8_t *data;                            // PROGMEM: the frames back to back
+    uint8_t width;                                  // columns
+    uint8_t pages;                                  // height in pages
+    uint8_t count;                                  // number of frames
+    uint8_t format;                                 // OLED_FRAMES_RAW / OLED_FRAMES_DELTA
+};
+
+struct OLED_ANIM {
+    OLED_FRAMES frames;                             // RAM copy of the descriptor
+    uint8_t x;                                      // left edge (pixels)
+    uint8_t page;                                   // top page
+    uint8_t loop;                                   // 1 = start over after the last frame
+    uint8_t index;                                  // frame shown
+    const uint8_t *next;                            // delta: PROGMEM data of the frame after it
+    uint32_t start;                                 // D_ANIM_TICK time of frame 0
+    uint32_t played;                                // frames shown or dropped since the start
+    uint16_t interval;                              // time between two frames, in D_ANIM_TICK units
+    uint32_t dropped;                               // frames skipped because they were already late
+    uint8_t queued;                                 // async: queue index just after its last frame
+    uint8_t shown[OLED_ANIM_MAX];                   // frame on the display
+};
+
+
+class SSD1306_OLED_HW_I2C_LIB
+#if OLED_PRINT
+    : public Print
+#endif
+{
 
   public: 
 
-    SSD1306_OLED_HW_I2C_LIB(void);
+    // scl_hz = I2C clock in Hz, set by D_INIT (0 = keep the clock already set up, else TWBR 2, ~800 kHz at 16 MHz;
+    //          Wire: the core's default; SPI: the SPI clock, 0 = OLED_SPI_CLOCK)
+    // address = 7-bit (0x3C) or 8-bit (0x78) address (not used over SPI)
+#if OLED_FIXED_GEOMETRY
+    SSD1306_OLED_HW_I2C_LIB(uint32_t scl_hz = 0, uint8_t address = SLA_W);
+#else
+    // width, height = panel size, at most OLED_WIDTH x OLED_HEIGHT (height: 16, 32, 48 or 64)
+    // profile = OLED_PROFILE_*, col_offset = first GDDRAM column of the panel (OLED_COL_AUTO: from the width)
+    SSD1306_OLED_HW_I2C_LIB(uint32_t scl_hz = 0, uint8_t address = SLA_W, uint8_t width = OLED_WIDTH,
+                            uint8_t height = OLED_HEIGHT, uint8_t profile = OLED_INIT_PROFILE,
+                            uint8_t col_offset = OLED_COL_OFFSET);
+#endif
+    ~SSD1306_OLED_HW_I2C_LIB();
 
     void D_INIT(void);
+    void D_REINIT_FAST(void);                       // restore the setup after a display power glitch or reset
     void D_SETPOS(uint8_t x, uint8_t y);
     void D_CLEAR(void);
+    void D_FILL(uint8_t pattern);                   // fill the screen with a byte pattern (8 vertical pixels)
+    void D_FILL_RECT(uint8_t xpos, uint8_t page, uint8_t width, uint8_t pages, uint8_t pattern);
+    void D_BLANK(uint8_t mode);                     // OLED_BLANK_*: hide / show GDDRAM without clearing it
     void D_CONTRAST (uint8_t contrast);
     void D_ON(void);
     void D_OFF(void);
+    void D_SET_IDLE(uint32_t dim_after, uint32_t off_after, uint8_t dim_contrast);   // times in D_IDLE_TICK units, 0 = never
+    void D_IDLE_TICK(uint32_t now);                 // call from the main loop, e.g. D_IDLE_TICK(millis())
+    void D_WAKE(void);                              // undo dimming / power down (done by the next data sent anyway)
+    uint8_t D_POWER(void);                          // OLED_POWER_*
+    void D_SLEEP_WAIT(void);                        // D_WAIT() in MCU idle sleep (async mode)
+    void D_SET_FONT(const OLED_FONT *font);        // font used by D_PRINT_* (descriptor in PROGMEM)
+    uint8_t D_TEXT_WIDTH(const char *s);            // width of a string in pixels in the current font (unscaled)
+    void D_SET_SCALE(uint8_t scale);                // D_PRINT_* text size: 1, 2, 4 or 8 times
+    void D_PRINT_STR_SCALED(const char *s, uint8_t scale);
     void D_PRINT_CHAR(char ch);
-    void D_PRINT_STR(char *s);
+    void D_PRINT_STR(const char *s);
+    void D_PRINT_STR_P(const char *s);              // string in PROGMEM, e.g. D_PRINT_STR_P(PSTR("text"))
+    void D_PRINTF(const char *format, ...);         // %d %i %u %x %X %c %s %S (PROGMEM) %%, flags - 0, width, l
+    void D_PRINTF_P(const char *format, ...);       // format string in PROGMEM
+    void D_PRINT_BEGIN(void);                       // text output up to D_PRINT_END shares one data transaction
+    void D_PRINT_END(void);
+    size_t write(uint8_t ch);                       // Print interface: one character ('\n' = new line, '\r' ignored)
+    size_t write(const uint8_t *buffer, size_t size);
+#if OLED_PRINT
+    using Print::write;
+#endif
     void D_PRINT_INT(uint16_t num);
+    void D_PRINT_UINT(uint32_t num, uint8_t width = 0, char pad = ' ');
+    void D_PRINT_SINT(int32_t num, uint8_t width = 0, char pad = ' ');
+    void D_PRINT_HEX(uint32_t num, uint8_t digits = 0);
+    void D_PRINT_FIXED(int32_t value, uint8_t decimals, uint8_t width = 0, char pad = ' ');
+    void D_FIELD_INIT(OLED_FIELD *field, uint8_t x, uint8_t y, uint8_t width);
+    void D_FIELD_UINT(OLED_FIELD *field, uint32_t num);
+    void D_FIELD_SINT(OLED_FIELD *field, int32_t num);
+    void D_PLOT_INIT(OLED_PLOT *plot, uint8_t x, uint8_t page, uint8_t width, uint8_t pages, int16_t min, int16_t max, uint8_t mode);
+    void D_PLOT_PUSH(OLED_PLOT *plot, int16_t value);   // add a sample, sends only the columns that change
+    void D_PLOT_REDRAW(OLED_PLOT *plot);            // draw the whole plot again (e.g. after D_CLEAR)
+    void D_GRID_INIT(OLED_GRID *grid);              // all spaces, the first D_GRID_FLUSH draws every cell
+    void D_GRID_CLEAR(OLED_GRID *grid);             // set all cells to spaces
+    void D_GRID_CHAR(OLED_GRID *grid, uint8_t col, uint8_t row, char ch);
+    void D_GRID_STR(OLED_GRID *grid, uint8_t col, uint8_t row, const char *s, uint8_t attr = 0);   // clipped at the end of the row
+    void D_GRID_FLUSH(OLED_GRID *grid);             // send the changed cells
+    void D_GRID_REDRAW(OLED_GRID *grid);            // send every cell again (e.g. after D_CLEAR)
+    void D_ANIM_START(OLED_ANIM *anim, const OLED_FRAMES *frames, uint8_t x, uint8_t page, uint16_t interval, uint8_t loop, uint32_t now);
+    uint8_t D_ANIM_TICK(OLED_ANIM *anim, uint32_t now);     // draw the frame due at 'now', 0 once the animation has ended
+    void D_ANIM_REDRAW(OLED_ANIM *anim);            // draw the current frame again (e.g. after D_CLEAR)
     void D_DRAW_HOR(uint8_t xpos, uint8_t ypos, uint8_t length);
     void D_DRAW_VERT(uint8_t xpos, uint8_t ypos, uint8_t length);
+    void D_DRAW_BOX(uint8_t xpos, uint8_t ypos, uint8_t width, uint8_t height);
+    void D_DRAW_FRAME(uint8_t xpos, uint8_t ypos, uint8_t width, uint8_t height);
+    void D_SET_DRAW_MODE(uint8_t mode);             // OLED_DRAW_*: how lines, boxes and shapes go into fb[]
+    void D_PIXEL(uint8_t x, uint8_t y);             // pixel primitives: framebuffer mode only (no effect otherwise)
+    uint8_t D_GET_PIXEL(uint8_t x, uint8_t y);
+    void D_LINE(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1);
+    void D_CIRCLE(uint8_t x, uint8_t y, uint8_t r);
+    void D_FILL_CIRCLE(uint8_t x, uint8_t y, uint8_t r);
+    void D_DRAW_BITMAP(uint8_t xpos, uint8_t page, uint8_t width, uint8_t pages, const uint8_t *bitmap);      // PROGMEM
+    void D_DRAW_BITMAP_RAM(uint8_t xpos, uint8_t page, uint8_t width, uint8_t pages, const uint8_t *bitmap);  // SRAM
+    void D_DRAW_BITMAP_RLE(uint8_t xpos, uint8_t page, uint8_t width, uint8_t pages, const uint8_t *bitmap);  // PROGMEM, run-length encoded
 
     void D_DEMO(void);
 
+    void D_SCROLL_H(uint8_t left, uint8_t start_page, uint8_t end_page, uint8_t speed);
+    void D_SCROLL_DIAG(uint8_t left, uint8_t start_page, uint8_t end_page, uint8_t speed, uint8_t rows);
+    void D_SCROLL_STOP(void);
+    void D_START_LINE(uint8_t line);                // GDDRAM row shown at the top (0-63)
+    void D_CONSOLE_CLEAR(void);
+    void D_CONSOLE_LINE(const char *s);             // append a line of text, scrolling via the start line
+
+    uint32_t D_SET_CLOCK(uint32_t scl_hz);          // set I2C clock from F_CPU, returns the actual frequency (0 = keep it)
+    uint32_t D_GET_CLOCK(void);
+    uint32_t D_TUNE_CLOCK(uint32_t min_hz, uint32_t max_hz);   // use the fastest clock the display ACKs reliably
+
+    void D_ON_ERROR(void (*handler)(uint8_t status));   // called with an OLED_ERR_* code on I2C errors
+    void D_ON_YIELD(void (*handler)(void), uint16_t bytes);   // called every 'bytes' bytes sent (blocking mode, 0 = never)
+    void D_SET_RETRIES(uint8_t count);
+    uint8_t D_STATUS(void);                         // last error since the previous call, OLED_OK if none
+    static void D_BUS_RECOVER(void);                // clock out a slave holding SDA low, then STOP
+    static void D_GET_STATS(OLED_BUS_STATS *stats); // copy the bus counters (all 0 unless OLED_STATS is 1)
+    static void D_RESET_STATS(void);
+    void D_SET_MUX(uint8_t address, uint8_t channel);   // display behind a TCA9548A (0x70-0x77, channel 0-7), 0 = none
+
+    void D_BATCH_BEGIN(void);                       // merge the following transactions (see "Transactions")
+    void D_BATCH_END(void);
+    void D_FLUSH(void);                             // send changed areas of the framebuffer (framebuffer mode)
+    void D_SWAP(void);                              // show the back buffer and keep drawing on a copy (double buffering)
+    static uint8_t D_FLUSH_STEP(void);              // send one dirty page of the next display, 0 once all are clean
+    static void D_FLUSH_ALL(void);                  // flush every display, interleaving their pages
+
+    uint8_t D_BUSY(void);                           // 1 while queued transactions are still being sent
+    void D_WAIT(void);                              // wait until all queued transactions have been sent
+
+#if OLED_ASYNC
+    static void D_TWI_ISR(void);                    // TWI interrupt handler (used internally)
+#endif
+
   private:
 
     void CLK_DIV_1(void);
     void CLK_DIV_8(void);
-    uint8_t usint2decascii(uint16_t, char *);
+    char *D_UTOA(uint32_t num, char *end, uint8_t min_digits);
+    void D_PRINT_NUM(const char *digits, const char *end, uint8_t negative, uint8_t width, char pad);
+    void D_FIELD_SHOW(OLED_FIELD *field, const char *digits, const char *end, uint8_t negative);
+    uint8_t D_FIELD_CELL(void);
+    uint8_t D_CELL_BITS(const uint8_t *glyph, uint8_t width, uint8_t col, uint8_t page);
+    uint8_t D_PLOT_ROW(OLED_PLOT *plot, uint8_t col);
+    void D_PLOT_COLUMNS(OLED_PLOT *plot, uint8_t first, uint8_t last);
+    void D_GRID_SEND(OLED_GRID *grid, uint8_t first, uint8_t last, uint8_t row, uint8_t row_last);
+    const uint8_t *D_ANIM_APPLY(OLED_ANIM *anim, const uint8_t *src, uint8_t mode, uint8_t *lo, uint8_t *hi);
+    void D_ANIM_SEND(OLED_ANIM *anim, const uint8_t *lo, const uint8_t *hi);
+    void D_ANIM_AREA(OLED_ANIM *anim, uint8_t lo, uint8_t hi, uint8_t p0, uint8_t p1);
+
+    static uint8_t D_TWI_STEP(uint8_t control, uint8_t expect, uint8_t error);
+    static uint8_t D_WIRE_STATUS(uint8_t result);
+    static uint8_t BUS_START(uint8_t address, uint8_t repeated);   // bus transport (see "Bus transport")
+    static uint8_t BUS_WRITE(uint8_t data);
+    static uint8_t BUS_WRITE_BLOCK(const uint8_t *src, uint16_t count);
+    static uint8_t BUS_STOP(void);
+    uint8_t D_WRITE_BLOCK(const uint8_t *src, uint16_t count);
+    void D_YIELD_AFTER(uint16_t bytes);
+    static void BUS_INIT(void);
+    uint8_t D_MUX_TX(void);
+    uint8_t D_PROBE(void);
 
-    void D_ERROR(void);
-    void D_START_CMD(void);
-    void D_START_DAT(void);
-    void D_TX(uint8_t DATA);
+    void D_ERROR(uint8_t status);
+    uint8_t D_START(uint8_t control);
+    uint8_t D_START_CMD(void);
+    uint8_t D_START_DAT(void);
+    uint8_t D_TX(uint8_t DATA);
     void D_STOP (void);
+    uint8_t D_SEND(uint8_t DATA);                   // raw transaction layer (blocking or async) under the batch logic
+    void D_SEND_BLOCK(const uint8_t *src, uint8_t count);
+    void D_END(void);
+    void D_BATCH_FLUSH(void);
+    void D_BATCH_BREAK(void);
+    void D_CLAIM(void);
+    void D_ACTIVE(void);
+    uint8_t D_FLUSH_PAGE(void);
+
+    uint8_t sla_w;                                  // slave address + 0
+#if OLED_FIXED_GEOMETRY
+    enum {                                          // constants, see OLED_FIXED_GEOMETRY
+        disp_width = OLED_WIDTH,
+        disp_height = OLED_HEIGHT,
+        disp_pages = OLED_PAGES,
+        col_offset = (OLED_COL_OFFSET != OLED_COL_AUTO) ? OLED_COL_OFFSET : (OLED_WIDTH == 64) ? 32 : 0,
+        init_profile = OLED_INIT_PROFILE
+    };
+#else
+    uint8_t disp_width;                             // panel geometry (constructor)
+    uint8_t disp_height;
+    uint8_t disp_pages;
+    uint8_t col_offset;                             // first GDDRAM column of the panel
+    uint8_t init_profile;                           // OLED_PROFILE_*
+#endif
+    uint32_t scl_init;                              // clock set by D_INIT (0 = leave it)
+#if (OLED_TRANSPORT == OLED_TRANSPORT_WIRE) || (OLED_TRANSPORT == OLED_TRANSPORT_SPI)
+    static uint32_t bus_hz;                         // clock set by D_SET_CLOCK (the library cannot read it back)
+#endif
+    uint8_t mux_w;                                  // TCA9548A address + 0 (0 = not multiplexed)
+    uint8_t mux_mask;                               // channel bit selecting this display
+    static uint8_t mux_sel_w;                       // mux and channel last selected on the bus (0 = unknown)
+    static uint8_t mux_sel_mask;
+    SSD1306_OLED_HW_I2C_LIB *next_display;          // list of all instances (D_FLUSH_ALL)
+    static SSD1306_OLED_HW_I2C_LIB *displays;
+    static SSD1306_OLED_HW_I2C_LIB *flush_turn;     // display flushed last by D_FLUSH_STEP
+    static SSD1306_OLED_HW_I2C_LIB *bus_owner;      // display that started the last transaction
+    void (*error_handler)(uint8_t status);
+    void (*yield_handler)(void);                    // D_ON_YIELD
+    uint16_t yield_every;                           // bytes between two calls
+    uint16_t yield_left;                            // bytes until the next call
+    uint8_t con_lines;                              // console lines written so far (up to disp_pages)
+    uint8_t con_top;                                // GDDRAM page shown at the top of the console
+    uint8_t last_status;                            // last error, cleared by D_STATUS()
+    OLED_FONT font;                                 // RAM copy of the current font descriptor
+    uint8_t text_scale;                             // D_SET_SCALE
+#if OLED_GLYPH_CACHE
+    uint8_t glyph_cache[OLED_GLYPH_CACHE_LAST - OLED_GLYPH_CACHE_FIRST + 1][OLED_GLYPH_CACHE_COLS];   // spacing + columns
+    uint8_t glyph_cols[OLED_GLYPH_CACHE_LAST - OLED_GLYPH_CACHE_FIRST + 1];     // columns cached (0 = not cached)
+    uint8_t glyph_builtin;                          // 1 if the cache holds the built-in font (D_GLYPH_COL)
+#endif
+    uint8_t cur_x;                                  // text position: set by D_SETPOS, advanced by text output
+    uint8_t cur_page;
+    uint8_t pos_lost;                               // 1 while the RAM pointer is left in a text window
+    uint8_t print_nest;                             // D_PRINT_BEGIN calls not yet ended
+    uint8_t print_open;                             // 1 while D_PRINT_BEGIN holds a data transaction open
+    uint8_t contrast;                               // contrast set by D_CONTRAST (restored by D_WAKE)
+    uint8_t start_line;                             // set by D_START_LINE (restored by D_REINIT_FAST)
+    uint8_t power_state;                            // OLED_POWER_*
+    uint8_t idle_busy;                              // data has been sent since the last D_IDLE_TICK
+    uint8_t idle_contrast;                          // contrast while dimmed
+    uint32_t idle_dim;                              // idle time before dimming / powering down (0 = never)
+    uint32_t idle_off;
+    uint32_t idle_since;                            // D_IDLE_TICK time of the last activity
+    static uint8_t retries;
+#if OLED_STATS
+    static OLED_BUS_STATS stats;
+#ifdef OLED_STATS_CLOCK
+    static uint16_t irq_off_since;                  // OLED_STATS_CLOCK() when interrupts were disabled
+#endif
+#endif
+    uint8_t batch;                                  // 1 between D_BATCH_BEGIN and D_BATCH_END
+    uint8_t batch_open;                             // BATCH_*: transaction left open by the batch
+    uint8_t batch_collect;                          // 1 while command bytes are being held back
+    uint8_t batch_len;
+    uint8_t batch_cmd[OLED_BATCH_MERGE];            // held-back commands, sent with Co=1 in front of the next data
+#if !OLED_ASYNC
+    uint8_t tx_status;                              // status of the transaction in progress
+#if OLED_IRQ_OFF
+    uint8_t irq_sreg;                               // SREG before the transaction disabled interrupts
+#endif
+#endif
+
+    void D_WINDOW(uint8_t x0, uint8_t x1, uint8_t p0, uint8_t p1);
+    uint8_t D_CLIP(uint8_t xpos, uint8_t ypos, uint8_t width, uint8_t height, uint8_t *xlast, uint8_t *ylast);
+    uint8_t D_PAGE_BITS(uint8_t page, uint8_t ytop, uint8_t ybottom);
+    void D_BLIT(uint8_t xpos, uint8_t page, uint8_t width, uint8_t pages, const uint8_t *bitmap, uint8_t source);
+
+    void D_TX_RANGE(uint8_t x0, uint8_t x1, uint8_t p0, uint8_t p1);
+    void D_TX_GEOMETRY(uint8_t all);
+    void D_TX_FILL(uint8_t data, uint16_t count);
+    void D_TX_BLOCK(const uint8_t *src, uint16_t count);
+
+    void D_DATA_BEGIN(void);
+    void D_PUT(uint8_t data);
+    void D_PUT_BLOCK(const uint8_t *src, uint8_t count);
+    void D_DATA_END(void);
+    uint8_t D_GLYPH_COL(char ch, uint8_t col);
+    const uint8_t *D_FONT_GLYPH(char ch, uint8_t *width);
+    void D_TEXT(const char *s, uint8_t scale, uint8_t flash = 0);
+    void D_GLYPH_OUT(char ch);
+    void D_STREAM_CHAR(char ch);
+    uint8_t D_STR_WIDTH(const char *s, uint8_t flash);
+    void D_VPRINTF(const char *format, uint8_t flash, va_list args);
+    uint8_t D_SCALE_BITS(uint8_t bits, uint8_t scale);
+    void D_CONSOLE_PAGE(uint8_t page, const char *s);
+
+#if OLED_FRAMEBUFFER
+    void FB_MARK(uint8_t x, uint8_t page);
+    void FB_PUT(uint8_t data);
+    void FB_DRAW(uint8_t x, uint8_t page, uint8_t bits);
+    void FB_PIXEL(int16_t x, int16_t y);
+    void FB_COLUMN(int16_t x, int16_t ytop, int16_t ybottom);
+    void FB_CIRCLE_POINTS(int16_t x, int16_t y, int16_t dx, int16_t dy);
+    void FB_RESEND(void);
+
+#if OLED_DOUBLE_BUFFER
+    uint8_t fb_buf[2][OLED_WIDTH * OLED_PAGES];     // back and front buffer
+    uint8_t *fb;                                    // back buffer: drawing goes here
+    uint8_t *fb_front;                              // front buffer: the frame last sent
+    uint8_t fb_sent;                                // 0 until the first swap (GDDRAM contents unknown)
+#if OLED_PAGE_FLIP
+    uint8_t fb_half;                                // half of GDDRAM shown (0: pages 0-3, 1: pages 4-7)
+    uint8_t last_lo[OLED_PAGES];                    // columns sent to the other half by the previous swap
+    uint8_t last_hi[OLED_PAGES];
+#endif
+#else
+    uint8_t fb[OLED_WIDTH * OLED_PAGES];            // RAM copy of GDDRAM: disp_pages pages of disp_width columns
+#endif
+    uint8_t dirty_lo[OLED_PAGES];                   // first changed column of each page (> dirty_hi when clean)
+    uint8_t dirty_hi[OLED_PAGES];                   // last changed column of each page
+    uint8_t fb_x;                                   // RAM pointer, advanced like the controller's GDDRAM pointer
+    uint8_t fb_page;
+    uint8_t fb_x0, fb_x1, fb_p0, fb_p1;             // RAM pointer window (see D_WINDOW)
+    uint8_t flush_page;                             // page D_FLUSH_PAGE looks at next
+    uint8_t draw_mode;                              // OLED_DRAW_*
+#else
+    uint8_t win_full;                               // 0 while D_WINDOW has left a partial column/page range set
+#endif
+
+#if OLED_ASYNC
+    void Q_OPEN(uint8_t control);
+    void Q_CLOSE(void);
+    void Q_REPORT(void);
+    void Q_GENERATED(const uint8_t *header, uint8_t size);
+    void Q_MUX(void);
+    static void Q_SPIN(void);
+    static uint8_t Q_PENDING(uint8_t mark);
+
+    static volatile uint8_t q_buf[OLED_QUEUE_SIZE]; // framed transactions: [length][address][control byte][payload...]
+    static volatile uint8_t q_head;                 // end of the published frames (written by the producer)
+    static volatile uint8_t q_tail;                 // next byte to be sent (written by the ISR)
+    static volatile uint8_t q_left;                 // bytes left in the frame being sent by the ISR
+    static volatile uint8_t q_busy;                 // 1 while the ISR owns the bus
+    static volatile uint8_t q_start;                // start of the frame being sent (for a resend)
+    static volatile uint8_t q_tries;                // resends of the frame being sent
+    static volatile uint8_t q_status;               // error recorded by the ISR, not reported yet
+    static volatile uint8_t q_fill;                 // value of the fill frame being sent
+    static volatile uint16_t q_repeat;              // generated bytes of the fill / block frame still to send
+    static const uint8_t * volatile q_src;          // next byte of a block frame (0 for a fill frame)
+    static volatile uint8_t q_ticks;                // incremented by every interrupt (stall detection)
+    static uint8_t q_wr;                            // producer write index of the frame being built
+    static uint8_t q_frame;                         // index of the length byte of the frame being built
+    static uint8_t q_control;                       // control byte of the frame being built
+    static uint8_t q_seen;                          // q_ticks at the last poll (stall detection)
+    static uint16_t q_spins;                        // polls without progress
+#endif
 };
 
 #endif
@@ -2,7 +2,7 @@
 // Demo sketch - uses built in demonstration function, D_DEMO()
 //
 // connect display SCL to pin A5, and SDA to pin A4
-// connect LED to pin 4 (it will blink in case of I2C error)
+// connect LED to pin 4 (it will light up in case of I2C error)
 
 #include <SSD1306_OLED_HW_I2C_LIB.h>
 #include <avr/io.h>
@@ -0,0 +1,131 @@
+// SSD1306_OLED_HW_I2C_LIB_Benchmark.ino
+// Benchmark sketch - times the drawing primitives at several I2C clock rates and reports over Serial (115200 baud)
+//
+// connect display SCL to pin A5, and SDA to pin A4
+// connect LED to pin 4 (it will light up in case of I2C error)
+//
+// Each test is repeated RUNS times. The report lists the average time per call in microseconds, calls per
+// second (frames per second for the full-screen tests) and, when the library is built with OLED_STATS 1,
+// the I2C bytes per call and the resulting bytes per second. In async mode every test ends with D_WAIT(),
+// so the time includes the transfer. In framebuffer mode every test ends with D_FLUSH().
+// Keep the output of a known-good build as the baseline to compare library versions and boards against.
+
+#include <SSD1306_OLED_HW_I2C_LIB.h>
+#include <avr/io.h>
+
+SSD1306_OLED_HW_I2C_LIB lcd = SSD1306_OLED_HW_I2C_LIB();
+
+#define RUNS  20
+
+const uint32_t clocks[] = { 100000, 400000, 800000 };     // SCL rates to test (800 kHz is the library default)
+
+uint8_t test_no;                                          // test being run, for the tests that vary per run
+uint8_t run_no;
+
+void test_clear(void)       { lcd.D_CLEAR(); }
+void test_fill(void)        { lcd.D_FILL(run_no & 1 ? 0xFF : 0x00); }
+void test_print_str(void)   { lcd.D_SETPOS(0, run_no & 7); lcd.D_PRINT_STR("Benchmark 0123456789"); }
+void test_print_int(void)   { lcd.D_SETPOS(0, run_no & 7); lcd.D_PRINT_INT(run_no * 1234); }
+void test_print_2x(void)    { lcd.D_SETPOS(0, (run_no & 3) * 2); lcd.D_PRINT_STR_SCALED("Scaled 2x", 2); }
+void test_draw_hor(void)    { lcd.D_DRAW_HOR(0, run_no & 63, OLED_WIDTH); }
+void test_draw_vert(void)   { lcd.D_DRAW_VERT(run_no & 127, 0, OLED_HEIGHT); }
+void test_draw_box(void)    { lcd.D_DRAW_BOX(16, 8, 96, 48); }
+void test_fill_rect(void)   { lcd.D_FILL_RECT(16, 1, 96, 6, 0x55); }
+
+void test_setpos_8(void) {                                // 8 short labels, one transaction each
+  for (uint8_t row = 0; row < 8; row++) {
+    lcd.D_SETPOS(run_no & 63, row);
+    lcd.D_PRINT_STR("42");
+  }
+}
+
+void test_batched_8(void) {                               // the same in a batch (Co=1 prefixes, repeated START)
+  lcd.D_BATCH_BEGIN();
+  test_setpos_8();
+  lcd.D_BATCH_END();
+}
+
+struct Test {
+  const char *name;
+  void (*run)(void);
+  uint8_t frame;                                          // 1 = full screen: report frames per second
+};
+
+const Test tests[] = {
+  { "D_CLEAR",            test_clear,      1 },
+  { "D_FILL",             test_fill,       1 },
+  { "D_PRINT_STR 20ch",   test_print_str,  0 },
+  { "D_PRINT_INT",        test_print_int,  0 },
+  { "D_PRINT_STR_SCALED", test_print_2x,   0 },
+  { "D_DRAW_HOR",         test_draw_hor,   0 },
+  { "D_DRAW_VERT",        test_draw_vert,  0 },
+  { "D_DRAW_BOX 96x48",   test_draw_box,   0 },
+  { "D_FILL_RECT 96x6",   test_fill_rect,  0 },
+  { "8x SETPOS+PRINT",    test_setpos_8,   0 },
+  { "8x batched",         test_batched_8,  0 },
+};
+
+void setup(void) {
+  Serial.begin(115200);
+  lcd.D_INIT();
+  lcd.D_CONTRAST(0x7F);
+}
+
+void loop(void) {
+  for (uint8_t c = 0; c < sizeof(clocks) / sizeof(clocks[0]); c++) {
+    uint32_t scl = lcd.D_SET_CLOCK(clocks[c]);
+    Serial.print(F("\nSCL "));
+    Serial.print(scl);
+    Serial.print(F(" Hz (TWBR "));
+    Serial.print(TWBR);
+    Serial.print(F(", TWPS "));
+    Serial.print(TWSR & 0x03);
+    Serial.println(F(")"));
+    Serial.println(F("test                  us/call   calls/s   bytes/call   bytes/s"));
+
+    for (test_no = 0; test_no < sizeof(tests) / sizeof(tests[0]); test_no++) {
+      lcd.D_CLEAR();
+      lcd.D_FLUSH();
+      lcd.D_WAIT();
+      SSD1306_OLED_HW_I2C_LIB::D_RESET_STATS();
+      uint32_t start = micros();
+      for (run_no = 0; run_no < RUNS; run_no++) {
+        tests[test_no].run();
+        lcd.D_FLUSH();
+      }
+      lcd.D_WAIT();
+      uint32_t us = (micros() - start) / RUNS;
+      OLED_BUS_STATS stats;
+      SSD1306_OLED_HW_I2C_LIB::D_GET_STATS(&stats);
+      uint32_t bytes = stats.bytes / RUNS;
+
+      print_col(tests[test_no].name, 20);
+      print_num(us, 9);
+      print_num(us ? 1000000UL / us : 0, 10);
+      if (stats.bytes) {
+        print_num(bytes, 13);
+        print_num(us ? bytes * 1000000UL / us : 0, 10);
+      } else {
+        Serial.print(F("            -         -"));   // library built without OLED_STATS
+      }
+      if (tests[test_no].frame) Serial.print(F("  (frames/s)"));
+      Serial.println();
+      if (lcd.D_STATUS() != OLED_OK) Serial.println(F("  I2C error"));
+    }
+  }
+  lcd.D_SET_CLOCK(clocks[sizeof(clocks) / sizeof(clocks[0]) - 1]);
+  delay(10000);
+}
+
+void print_col(const char *s, uint8_t width) {            // left-aligned text column
+  uint8_t n = 0;
+  for (; s[n]; n++) Serial.print(s[n]);
+  for (; n < width; n++) Serial.print(' ');
+}
+
+void print_num(uint32_t value, uint8_t width) {           // right-aligned number column
+  uint8_t digits = 1;
+  for (uint32_t v = value; v >= 10; v /= 10) digits++;
+  for (; digits < width; digits++) Serial.print(' ');
+  Serial.print(value);
+}
@@ -2,7 +2,7 @@
 // Demo sketch
 //
 // connect display SCL to pin A5, and SDA to pin A4
-// connect LED to pin 4 (it will blink in case of I2C error)
+// connect LED to pin 4 (it will light up in case of I2C error)
 
 #include <SSD1306_OLED_HW_I2C_LIB.h>
 #include <avr/io.h>
@@ -38,10 +38,12 @@ void DemoScreen(void) {                                         // display demon
        lcd.D_PRINT_STR("turned off");
        lcd.D_SETPOS(30,5);
        lcd.D_PRINT_STR("temporarily");
+       lcd.D_FLUSH();                                          // send the screen (only needed in framebuffer mode)
         _delay_ms(2000);
        lcd.D_OFF();                                            // turn off display (conserve power)
         _delay_ms(500);
        lcd.D_CLEAR();
+       lcd.D_FLUSH();
        lcd.D_ON();                                             // turn on display
         _delay_ms(500);
 
@@ -50,15 +52,18 @@ void DemoScreen(void) {                                         // display demon
         for (uint16_t i = 800; i>0; i--) {
            lcd.D_SETPOS(2+13*6,3);
            lcd.D_PRINT_INT(i);                                 // print counter variable
+           lcd.D_FLUSH();
         }
     
        lcd.D_CLEAR();
        lcd.D_SETPOS(18,4);
        lcd.D_PRINT_STR("LOWEST CONTRAST");
+       lcd.D_FLUSH();
         _delay_ms(1000);
        lcd.D_CONTRAST(0xFF);                                   // change contrast (0-255 or 0x00-0xFF)
        lcd.D_SETPOS(14,4);
        lcd.D_PRINT_STR("HIGHEST CONTRAST");
+       lcd.D_FLUSH();
         _delay_ms(1000);
        lcd.D_CONTRAST(0x00);
 }
@@ -2,7 +2,7 @@
 // Test sketch
 //
 // connect display SCL to pin A5, and SDA to pin A4
-// connect LED to pin 4 (it will blink in case of I2C error)
+// connect LED to pin 4 (it will light up in case of I2C error)
 
 #include <SSD1306_OLED_HW_I2C_LIB.h>
 #include <avr/io.h>
@@ -10,7 +10,7 @@
 SSD1306_OLED_HW_I2C_LIB lcd = SSD1306_OLED_HW_I2C_LIB();
 
 void setup(void) {
-  lcd.DINIT();
+  lcd.D_INIT();
 }
 
 
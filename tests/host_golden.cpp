@@ -0,0 +1,497 @@
+/*
+** host_golden.cpp — golden-image and render-cost tests for SSD1306_OLED_HW_I2C_LIB on the SSD1306 emulator
+** Part of SSD1306_OLED_HW_I2C_LIB, see SSD1306_OLED_HOST.h
+
+Build and run from the library folder, once per drawing mode (the exit status is the number of failures):
+
+    g++ -I. SSD1306_OLED_HW_I2C_LIB.cpp SSD1306_OLED_HOST.cpp tests/host_golden.cpp -o host_golden && ./host_golden
+    g++ -I. -DOLED_FRAMEBUFFER=1 SSD1306_OLED_HW_I2C_LIB.cpp SSD1306_OLED_HOST.cpp tests/host_golden.cpp -o host_golden && ./host_golden
+    g++ -I. -DOLED_ASYNC=1 -DOLED_FRAMEBUFFER=1 -DOLED_DOUBLE_BUFFER=1 -DOLED_HEIGHT=32 ...       (any mode and panel size)
+
+Every case draws on a cleared screen and compares the top left of the emulated display with an image
+('#' = lit, '.' = dark, everything outside it must be dark), then the transactions and data bytes the
+drawing cost (framebuffer mode: including the D_FLUSH) with the expected counts of the build's mode.
+Async builds run the queue against the emulator's TWI model (oled_host_twi_hold holds it back).
+*/
+
+#include "SSD1306_OLED_HW_I2C_LIB.h"
+#include "SSD1306_OLED_HOST.h"
+
+static int failures = 0;
+
+static void check(const char *name, int ok) {
+    printf("%-34s %s\n", name, ok ? "ok" : "FAILED");
+    if (!ok) failures++;
+}
+
+static int image_is(const OLED_HOST_PANEL *panel, const char *const *rows, uint8_t height) {
+    for (uint8_t y = 0; y <= panel->mux_ratio; y++) {                  // the panel's own geometry
+        for (uint8_t x = 0; x < panel->width; x++) {
+            uint8_t want = (y < height && x < strlen(rows[y])) ? rows[y][x] == '#' : 0;
+            if (oled_host_pixel(panel, x, y) != want) {
+                printf("  pixel (%u, %u) is %u\n", x, y, !want);
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+struct Cost {
+    uint32_t transactions, data;
+};
+
+static Cost cost_since(const OLED_HOST_PANEL *panel, const Cost &start) {
+    Cost c = { panel->transactions - start.transactions, panel->data - start.data };
+    return c;
+}
+
+static void flush(SSD1306_OLED_HW_I2C_LIB &lcd) {
+#if OLED_FRAMEBUFFER
+    lcd.D_FLUSH();
+#else
+    (void)lcd;
+#endif
+}
+
+static OLED_HOST_PANEL *blank_screen(SSD1306_OLED_HW_I2C_LIB &lcd, Cost *start) {
+    oled_host_reset();
+    lcd.D_INIT();
+    lcd.D_CLEAR();
+    flush(lcd);
+    flush(lcd);                                     // page flip: the other half of GDDRAM too
+    OLED_HOST_PANEL *panel = oled_host_find(SLA_W, 0);
+    start->transactions = panel->transactions;
+    start->data = panel->data;
+    return panel;
+}
+
+static uint8_t reference[64][128];                                      // screen of a reference rendering
+
+static void keep_reference(const OLED_HOST_PANEL *panel) {
+    for (uint8_t y = 0; y < 64; y++) {
+        for (uint8_t x = 0; x < 128; x++) reference[y][x] = oled_host_pixel(panel, x, y);
+    }
+}
+
+static int same_as_reference(const OLED_HOST_PANEL *panel) {
+    for (uint8_t y = 0; y < 64; y++) {
+        for (uint8_t x = 0; x < 128; x++) {
+            if (oled_host_pixel(panel, x, y) != reference[y][x]) {
+                printf("  pixel (%u, %u) is %u\n", x, y, !reference[y][x]);
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+// Expected cost per drawing mode: direct, framebuffer, double buffer, double buffer with page flip
+#if OLED_FRAMEBUFFER && OLED_DOUBLE_BUFFER && OLED_PAGE_FLIP
+#define EXPECT(direct, fb, swap, flip)  (flip)
+#elif OLED_FRAMEBUFFER && OLED_DOUBLE_BUFFER
+#define EXPECT(direct, fb, swap, flip)  (swap)
+#elif OLED_FRAMEBUFFER
+#define EXPECT(direct, fb, swap, flip)  (fb)
+#else
+#define EXPECT(direct, fb, swap, flip)  (direct)
+#endif
+
+static void check_cost(const char *name, Cost c, uint32_t transactions, uint32_t data) {
+    if (c.transactions != transactions || c.data != data) {
+        printf("  %u transactions, %u data bytes (expected %u, %u)\n", c.transactions, c.data, transactions, data);
+    }
+    check(name, c.transactions == transactions && c.data == data);
+}
+
+static void test_text(void) {
+    static const char *const golden[] = {
+        ".#...#...#",
+        ".#...#....",
+        ".#...#..##",
+        ".#####...#",
+        ".#...#...#",
+        ".#...#...#",
+        ".#...#..###",
+    };
+    SSD1306_OLED_HW_I2C_LIB lcd;
+    Cost start;
+    OLED_HOST_PANEL *panel = blank_screen(lcd, &start);
+    lcd.D_SETPOS(0, 0);
+    lcd.D_PRINT_STR("Hi");
+    flush(lcd);
+    check("text: image", image_is(panel, golden, 7));
+    check_cost("text: cost", cost_since(panel, start), EXPECT(2, 2, 2, 3), EXPECT(12, 12, 10, 10));
+}
+
+// The line shares page 0 with the text: in direct mode it is written as whole page bytes and erases the
+// text in the columns it covers (documented), with a framebuffer only its own pixel row changes.
+static void test_line_over_text(void) {
+#if OLED_FRAMEBUFFER
+    static const char *const golden[] = {
+        ".#...#...#",
+        ".#...#....",
+        ".#...#..##",
+        ".#####...#",
+        ".#...#...#",
+        "##########",
+        ".#...#..###",
+    };
+#else
+    static const char *const golden[] = {
+        "",
+        "",
+        "",
+        "",
+        "",
+        "##########",
+        "..........#",
+    };
+#endif
+    SSD1306_OLED_HW_I2C_LIB lcd;
+    Cost start;
+    OLED_HOST_PANEL *panel = blank_screen(lcd, &start);
+    lcd.D_SETPOS(0, 0);
+    lcd.D_PRINT_STR("Hi");
+    flush(lcd);
+    start.transactions = panel->transactions;
+    start.data = panel->data;
+    lcd.D_DRAW_HOR(0, 5, 10);
+    flush(lcd);
+    check("line over text: image", image_is(panel, golden, 7));
+    check_cost("line over text: cost", cost_since(panel, start),        // FB: columns of 'H' and 'i' already lit,
+               EXPECT(2, 2, 2, 3), EXPECT(10, 9, 9, 11));                // flip: plus the text the other half missed
+}
+
+static void test_line_clipped(void) {
+    SSD1306_OLED_HW_I2C_LIB lcd;
+    Cost start;
+    OLED_HOST_PANEL *panel = blank_screen(lcd, &start);
+    lcd.D_DRAW_HOR(OLED_WIDTH - 28, 10, 200);       // runs past the right edge
+    flush(lcd);
+    uint8_t lit = 0, stray = 0;
+    for (uint8_t x = 0; x < OLED_WIDTH; x++) {
+        if (oled_host_pixel(panel, x, 10)) (x >= OLED_WIDTH - 28) ? lit++ : stray++;
+    }
+    check("clipped line: image", lit == 28 && stray == 0);
+}
+
+static void test_boxes(void) {
+    static const char *const golden[] = {
+        "", "", "", "", "", "", "", "", "",
+        "..............................######",
+        "....................#####.....#....#",
+        "....................#####.....#....#",
+        "....................#####.....#....#",
+        "..............................######",
+    };
+    SSD1306_OLED_HW_I2C_LIB lcd;
+    Cost start;
+    OLED_HOST_PANEL *panel = blank_screen(lcd, &start);
+    lcd.D_DRAW_BOX(20, 10, 5, 3);
+    lcd.D_DRAW_FRAME(30, 9, 6, 5);
+    flush(lcd);
+    check("boxes: image", image_is(panel, golden, 14));
+    check_cost("boxes: cost", cost_since(panel, start), EXPECT(4, 2, 2, 3), EXPECT(11, 16, 16, 16));
+}
+
+static void test_clear(void) {
+    SSD1306_OLED_HW_I2C_LIB lcd;
+    Cost start;
+    OLED_HOST_PANEL *panel = blank_screen(lcd, &start);
+    lcd.D_DRAW_BOX(0, 0, OLED_WIDTH, OLED_HEIGHT);
+    flush(lcd);
+    start.transactions = panel->transactions;
+    start.data = panel->data;
+    lcd.D_CLEAR();
+    flush(lcd);
+    check("clear: image", image_is(panel, 0, 0));
+    check_cost("clear: cost", cost_since(panel, start),
+               EXPECT(2, 2 * OLED_PAGES, 2 * OLED_PAGES, 2 * OLED_PAGES + 1), OLED_WIDTH * OLED_PAGES);
+}
+
+static void draw_labels(SSD1306_OLED_HW_I2C_LIB &lcd) {
+    lcd.D_SETPOS(0, 0);
+    lcd.D_PRINT_STR("Hi");
+    lcd.D_SETPOS(40, 1);
+    lcd.D_PRINT_STR("ok");
+    lcd.D_DRAW_HOR(0, 12, 20);
+    flush(lcd);
+}
+
+// The same drawing in a batch: the same picture in fewer transactions. In async mode the batch is sent
+// with the TWI interrupt held back first, so the queue is still busy and nothing is on the display yet.
+static void test_batch(void) {
+    SSD1306_OLED_HW_I2C_LIB lcd;
+    Cost start;
+    OLED_HOST_PANEL *panel = blank_screen(lcd, &start);
+    draw_labels(lcd);
+    keep_reference(panel);
+    Cost plain = cost_since(panel, start);
+    panel = blank_screen(lcd, &start);
+#if OLED_ASYNC
+    oled_host_twi_hold = 1;
+#endif
+    lcd.D_BATCH_BEGIN();
+    draw_labels(lcd);
+    lcd.D_BATCH_END();
+#if OLED_ASYNC
+    check("async batch: queued", lcd.D_BUSY() && cost_since(panel, start).data == 0);
+    oled_host_twi_hold = 0;
+    oled_host_twi_run(0xFFFF);
+    lcd.D_WAIT();
+    check("async batch: sent", !lcd.D_BUSY() && lcd.D_STATUS() == OLED_OK);
+#endif
+    Cost batched = cost_since(panel, start);
+    check("batch: image", same_as_reference(panel));
+#if OLED_FRAMEBUFFER
+    // D_FLUSH windows are too long for a Co=1 merge: the batch only saves STOP/START pairs, which are not counted
+    check("batch: cost", batched.transactions <= plain.transactions && batched.data == plain.data);
+#else
+    check("batch: cost", batched.transactions < plain.transactions && batched.data == plain.data);
+#endif
+}
+
+// A field shows the same glyphs as printed text, and a changed digit costs only its columns
+static void test_field(void) {
+    SSD1306_OLED_HW_I2C_LIB lcd;
+    Cost start;
+    OLED_HOST_PANEL *panel = blank_screen(lcd, &start);
+    lcd.D_SETPOS(12, 2);
+    lcd.D_PRINT_STR(" 798");
+    flush(lcd);
+    keep_reference(panel);
+    panel = blank_screen(lcd, &start);
+    OLED_FIELD field;
+    lcd.D_FIELD_INIT(&field, 12, 2, 4);
+    lcd.D_FIELD_UINT(&field, 799);
+    flush(lcd);
+    start.transactions = panel->transactions;
+    start.data = panel->data;
+    lcd.D_FIELD_UINT(&field, 798);
+    flush(lcd);
+    check("field: image", same_as_reference(panel));
+    check("field: cost", cost_since(panel, start).data <= EXPECT(6, 6, 6, 18));  // one glyph (page flip: the hidden half also gets "799")
+}
+
+// A two-page font of digits only (' ' and '-' are outside it and print blank): digit d is d + 1 in the
+// top page and a bar below it
+static const uint8_t tall_digits[] PROGMEM = {
+    0x01, 0x01, 0x01,  0x00, 0x7E, 0x00,    0x02, 0x02, 0x02,  0x00, 0x7E, 0x00,
+    0x03, 0x03, 0x03,  0x00, 0x7E, 0x00,    0x04, 0x04, 0x04,  0x00, 0x7E, 0x00,
+    0x05, 0x05, 0x05,  0x00, 0x7E, 0x00,    0x06, 0x06, 0x06,  0x00, 0x7E, 0x00,
+    0x07, 0x07, 0x07,  0x00, 0x7E, 0x00,    0x08, 0x08, 0x08,  0x00, 0x7E, 0x00,
+    0x09, 0x09, 0x09,  0x00, 0x7E, 0x00,    0x0A, 0x0A, 0x0A,  0x00, 0x7E, 0x00,
+};
+static const OLED_FONT tall_font PROGMEM = { tall_digits, 0, '0', '9', 3, 2, 1 };
+
+// A field in the current font leaves the text position after it, like printing its text does
+static void test_field_font(void) {
+    SSD1306_OLED_HW_I2C_LIB lcd;
+    Cost start;
+    OLED_HOST_PANEL *panel = blank_screen(lcd, &start);
+    lcd.D_SET_FONT(&tall_font);
+    lcd.D_SETPOS(10, 0);
+    lcd.D_PRINT_STR(" 4217");
+    flush(lcd);
+    keep_reference(panel);
+    panel = blank_screen(lcd, &start);
+    lcd.D_SET_FONT(&tall_font);
+    OLED_FIELD field;
+    lcd.D_FIELD_INIT(&field, 10, 0, 4);
+    lcd.D_FIELD_UINT(&field, 990);
+    lcd.D_FIELD_UINT(&field, 421);
+    lcd.D_PRINT_STR("7");
+    flush(lcd);
+    check("field font: image", same_as_reference(panel));
+}
+
+// A field running off the right edge is clipped, nothing wraps to the next line
+static void test_field_clip(void) {
+    SSD1306_OLED_HW_I2C_LIB lcd;
+    Cost start;
+    OLED_HOST_PANEL *panel = blank_screen(lcd, &start);
+    OLED_FIELD field;
+    lcd.D_FIELD_INIT(&field, OLED_WIDTH - 10, 0, 4);
+    lcd.D_FIELD_UINT(&field, 8888);
+    flush(lcd);
+    uint16_t inside = 0, stray = 0;
+    for (uint8_t y = 0; y < OLED_HEIGHT; y++) {
+        for (uint8_t x = 0; x < OLED_WIDTH; x++) {
+            if (!oled_host_pixel(panel, x, y)) continue;
+            if (y < 8 && x >= OLED_WIDTH - 10) inside++;
+            else stray++;
+        }
+    }
+    check("field clip: image", inside > 0 && stray == 0);
+}
+
+// A console with more lines than the panel has pages shows the last ones, top to bottom
+static void test_console(void) {
+    static const char *const lines[] = { "one", "two", "three", "four", "five", "six", "seven", "eight", "nine" };
+    SSD1306_OLED_HW_I2C_LIB lcd;
+    Cost start;
+    OLED_HOST_PANEL *panel = blank_screen(lcd, &start);
+    uint8_t first = 9 - OLED_PAGES;
+    for (uint8_t page = 0; page < OLED_PAGES; page++) {
+        lcd.D_SETPOS(0, page);
+        lcd.D_PRINT_STR(lines[first + page]);
+    }
+    flush(lcd);
+    keep_reference(panel);
+    panel = blank_screen(lcd, &start);
+    lcd.D_CONSOLE_CLEAR();
+    for (uint8_t i = 0; i < 9; i++) lcd.D_CONSOLE_LINE(lines[i]);
+    flush(lcd);
+    check("console: image", same_as_reference(panel));
+#if OLED_FRAMEBUFFER
+    // fb[] is the screen from row 0, also after the console and a moved start line
+    lcd.D_START_LINE(8);
+    lcd.D_SETPOS(0, 0);
+    lcd.D_PRINT_STR("X");
+    flush(lcd);
+    check("console: drawing after it", oled_host_pixel(panel, 1, 0) && !oled_host_pixel(panel, 3, 0));
+#endif
+}
+
+// Sweep plot: sample i in column i joined to the one before, a rising line from the bottom row to the top one
+static void test_plot(void) {
+    SSD1306_OLED_HW_I2C_LIB lcd;
+    Cost start;
+    OLED_HOST_PANEL *panel = blank_screen(lcd, &start);
+    OLED_PLOT plot;
+    lcd.D_PLOT_INIT(&plot, 8, 1, 16, 1, 0, 7, OLED_PLOT_SWEEP);
+    for (int16_t v = 0; v < 8; v++) lcd.D_PLOT_PUSH(&plot, v);
+    flush(lcd);
+    uint8_t ok = 1;
+    for (uint8_t i = 0; i < 8; i++) {
+        for (uint8_t row = 0; row < 8; row++) {
+            if (oled_host_pixel(panel, 8 + i, 8 + row) != (row == 7 - i || (i > 0 && row == 8 - i))) ok = 0;
+        }
+    }
+    check("plot: image", ok);
+}
+
+// Grid cells are the built-in glyphs; one changed cell costs one cell of data
+static void test_grid(void) {
+    SSD1306_OLED_HW_I2C_LIB lcd;
+    Cost start;
+    OLED_HOST_PANEL *panel = blank_screen(lcd, &start);
+    lcd.D_SETPOS(6, 1);
+    lcd.D_PRINT_STR("-12:5");                                           // OLED_GLYPH_CACHE: the cached characters
+    flush(lcd);
+    keep_reference(panel);
+    panel = blank_screen(lcd, &start);
+    static OLED_GRID grid;
+    lcd.D_GRID_INIT(&grid);
+    lcd.D_GRID_STR(&grid, 1, 1, "-12:4");
+    lcd.D_GRID_FLUSH(&grid);
+    flush(lcd);
+    start.transactions = panel->transactions;
+    start.data = panel->data;
+    lcd.D_GRID_CHAR(&grid, 5, 1, '5');
+    lcd.D_GRID_FLUSH(&grid);
+    flush(lcd);
+    check("grid: image", same_as_reference(panel));
+    check("grid: cost", cost_since(panel, start).data <= EXPECT(6, 6, 6, 30));   // one cell (page flip: the hidden half also gets "-12:4")
+}
+
+// Two raw frames played once: frame 0 at the start, frame 1 (the last, so the tick reports the end) one interval later
+static const uint8_t anim_data[] PROGMEM = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F,
+};
+static const OLED_FRAMES anim_frames PROGMEM = { anim_data, 8, 1, 2, OLED_FRAMES_RAW };
+
+static void test_anim(void) {
+    static const char *const golden[] = {
+        "", "", "", "", "", "", "", "",
+        "....########",
+        "....########",
+        "....########",
+        "....########",
+    };
+    SSD1306_OLED_HW_I2C_LIB lcd;
+    Cost start;
+    OLED_HOST_PANEL *panel = blank_screen(lcd, &start);
+    static OLED_ANIM anim;
+    lcd.D_ANIM_START(&anim, &anim_frames, 4, 1, 10, 0, 0);
+    uint8_t running = lcd.D_ANIM_TICK(&anim, 0);
+    flush(lcd);
+    check("anim: first frame", running && oled_host_pixel(panel, 4, 15) && oled_host_pixel(panel, 11, 8));
+    running = lcd.D_ANIM_TICK(&anim, 10);
+    flush(lcd);
+    check("anim: second frame", !running && image_is(panel, golden, 12));
+    check("anim: end", lcd.D_ANIM_TICK(&anim, 20) == 0 && anim.dropped == 0);
+#if OLED_ASYNC && !OLED_FRAMEBUFFER
+    // Other queued traffic does not hold a frame back, the animation's own unsent frame does
+    panel = blank_screen(lcd, &start);
+    oled_host_twi_hold = 1;
+    lcd.D_SETPOS(0, 4);
+    lcd.D_PRINT_STR("busy");
+    lcd.D_ANIM_START(&anim, &anim_frames, 4, 1, 10, 1, 0);
+    lcd.D_ANIM_TICK(&anim, 0);
+    check("anim: queued behind other traffic", anim.played == 1);
+    lcd.D_ANIM_TICK(&anim, 10);
+    check("anim: waits for its own frame", anim.played == 1);
+    oled_host_twi_hold = 0;
+    oled_host_twi_run(0xFFFF);
+    lcd.D_ANIM_TICK(&anim, 25);
+    check("anim: late frame dropped", anim.played == 3 && anim.dropped == 1);
+    lcd.D_WAIT();
+#endif
+}
+
+#if !OLED_FIXED_GEOMETRY
+// A 64x48 panel next to the default one (both clamped to the build's largest panel)
+#define SMALL_W                         ((OLED_WIDTH < 64) ? OLED_WIDTH : 64)
+#define SMALL_H                         ((OLED_HEIGHT < 48) ? OLED_HEIGHT : 48)
+
+static void test_two_panels(void) {
+    SSD1306_OLED_HW_I2C_LIB big;
+    SSD1306_OLED_HW_I2C_LIB small(0, 0x3D, SMALL_W, SMALL_H, OLED_PROFILE_SHORT);
+    Cost start;
+    OLED_HOST_PANEL *panel = blank_screen(big, &start);
+    small.D_INIT();
+    OLED_HOST_PANEL *glass = oled_host_find(0x3D, 0);
+    glass->width = SMALL_W;
+    glass->col_offset = (SMALL_W == 64) ? 32 : 0;
+    Cost small_start = { glass->transactions, glass->data };
+    small.D_CLEAR();
+    flush(small);
+    check("two panels: small clear cost", cost_since(glass, small_start).data == SMALL_W * SMALL_H / 8);
+    small.D_DRAW_FRAME(0, 0, 200, 200);                                 // clipped to the small panel
+    flush(small);
+    static char rows[SMALL_H][SMALL_W + 1];
+    const char *frame[SMALL_H];
+    for (uint8_t y = 0; y < SMALL_H; y++) {
+        for (uint8_t x = 0; x < SMALL_W; x++) {
+            rows[y][x] = (x == 0 || x == SMALL_W - 1 || y == 0 || y == SMALL_H - 1) ? '#' : '.';
+        }
+        frame[y] = rows[y];
+    }
+    check("two panels: small image", glass->mux_ratio == SMALL_H - 1 && image_is(glass, frame, SMALL_H));
+    check("two panels: big untouched", cost_since(panel, start).transactions == 0 && image_is(panel, 0, 0));
+}
+#endif
+
+int main(void) {
+    test_text();
+    test_line_over_text();
+    test_line_clipped();
+    test_boxes();
+    test_clear();
+    test_batch();
+    test_field();
+    test_field_font();
+    test_field_clip();
+    test_console();
+    test_plot();
+    test_grid();
+    test_anim();
+#if !OLED_FIXED_GEOMETRY
+    test_two_panels();
+#endif
+    printf("%d failure(s)\n", failures);
+    return failures;
+}